@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+
+import sys
+import argparse
+from os import cpu_count
+from os.path import abspath, join as joinpath, dirname
+from subprocess import run, DEVNULL
+from time import monotonic
+from typing import List, Dict
+
+DEFAULT_GAME = ['813', '1', '2', '3', '4', '7', '25', '50', '75']
+
+binary_path = joinpath(dirname(abspath(__file__)), 'build', 'numbers')
+
+def default_thread_counts() -> List[int]:
+	cpus = cpu_count() or 1
+	counts: List[int] = []
+	count = 1
+	while count < cpus * 2:
+		counts.append(count)
+		count *= 2
+	counts.append(cpus * 2)
+	return counts
+
+def measure(binary: str, threads: int, game: List[str], repeat: int) -> float:
+	best = float('inf')
+	for _ in range(repeat):
+		start_ts = monotonic()
+		run([binary, '--threads', str(threads), *game], stdout=DEVNULL, check=True)
+		best = min(best, monotonic() - start_ts)
+	return best
+
+def main() -> int:
+	parser = argparse.ArgumentParser(description=
+		'Measure how the solver scales with the number of threads. '
+		'Give several binaries to compare them (e.g. builds of different commits).')
+	parser.add_argument('-t', '--threads', type=lambda arg: [int(count) for count in arg.split(',')],
+		default=default_thread_counts(), help='comma separated thread counts (default: 1, 2, 4, ... 2 * cpus)')
+	parser.add_argument('-r', '--repeat', type=int, default=3, help='runs per measurement, the best one counts (default: 3)')
+	parser.add_argument('-b', '--binary', action='append', dest='binaries', help='binary to measure (default: build/numbers)')
+	parser.add_argument('game', nargs='*', default=DEFAULT_GAME, help='TARGET NUMBER... (default: %s)' % ' '.join(DEFAULT_GAME))
+	args = parser.parse_args()
+
+	binaries: List[str] = args.binaries or [binary_path]
+	times: Dict[str, Dict[int, float]] = {binary: {} for binary in binaries}
+
+	sys.stdout.write(f'game: {" ".join(args.game)}, cpus: {cpu_count()}\n\n')
+	sys.stdout.write('threads'.rjust(7))
+	for binary in binaries:
+		sys.stdout.write(f'  {"seconds":>8} {"speedup":>7}')
+	sys.stdout.write('\n')
+
+	for threads in args.threads:
+		sys.stdout.write(f'{threads:7}')
+		sys.stdout.flush()
+		for binary in binaries:
+			elapsed = times[binary][threads] = measure(binary, threads, args.game, args.repeat)
+			base = times[binary].get(1, times[binary][args.threads[0]])
+			sys.stdout.write(f'  {elapsed:8.3f} {base / elapsed:7.2f}')
+			sys.stdout.flush()
+		sys.stdout.write('\n')
+
+	if len(binaries) > 1:
+		sys.stdout.write('\n')
+		for index, binary in enumerate(binaries):
+			sys.stdout.write(f'column {index + 1}: {binary}\n')
+
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -24,6 +24,12 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <limits.h>
+#include <time.h>
+#include <math.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "panic.h"
 
@@ -46,12 +52,37 @@ static size_t get_cpu_count() {
 }
 #endif
 
+// Build with -DNUMBER_BITS=128 (make wide) for games with huge numbers.
+// printf() can't print 128 bit integers, so Numbers are always printed
+// with format_number() and parsed with scan_number().
+#ifndef NUMBER_BITS
+#	define NUMBER_BITS 64
+#endif
+
+#if NUMBER_BITS == 128
+typedef unsigned __int128 Number;
+#elif NUMBER_BITS == 64
 typedef uint64_t Number;
+#else
+#	error "NUMBER_BITS needs to be 64 or 128"
+#endif
+
+#define NUMBER_MAX ((Number)~(Number)0)
+// digits of NUMBER_MAX
+#define NUMBER_DIGITS (NUMBER_BITS == 128 ? 39 : 20)
+
 typedef uint16_t Index;
-#define PRIN "lu"
 #define PRII "u"
 #define MAX_NUMBERS (sizeof(size_t) * 8)
 
+#ifndef CACHE_LINE_SIZE
+#	define CACHE_LINE_SIZE 64
+#endif
+
+// Starts a new cache line, so state written by one thread doesn't share a
+// line with state that other threads are reading.
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE_SIZE)))
+
 // for generation:
 const Number NUMBERS[] = {
 	1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
@@ -64,6 +95,16 @@ typedef struct TargetRangeS {
 	Number end;
 } TargetRange;
 
+// Sorted set of disjoint, non-adjacent inclusive ranges. min and max are
+// cached so that most non-matching results are rejected without searching.
+typedef struct TargetSetS {
+	TargetRange *ranges;
+	size_t       count;
+	size_t       capacity;
+	Number       min;
+	Number       max;
+} TargetSet;
+
 typedef enum OpE {
 	OpVal = '0',
 	OpAdd = '+',
@@ -80,73 +121,416 @@ typedef enum PrintStyleE {
 
 typedef struct ElementS {
 	Op op;
+	Index index; // index into numbers for OpVal, used for checkpoints
 	Number value;
 } Element;
 
+// Upper bound of log2(value + 1) in fixed point with LOG_SCALE as one.
+typedef uint32_t LogBound;
+#define LOG_SCALE 65536
+
 typedef struct ValElementS {
-	Number value;
-	size_t ops_index;
+	Number   value;
+	Index    ops_index;
+	LogBound log; // sum of the bounds of this and all values below it
 } ValElement;
 
+// Lanes of a batch, see solve_batch(). Values are 32 bit, so more of them fit
+// into a vector register, which is enough for games out of NUMBERS[]. A batch
+// fills one register: Wider vectors than the hardware supports are split up
+// by the compiler and were slower than scalar code.
+#ifndef BATCH_LANES
+#	if defined(__AVX512F__)
+#		define BATCH_LANES 16
+#	elif defined(__AVX2__)
+#		define BATCH_LANES 8
+#	else
+#		define BATCH_LANES 4
+#	endif
+#endif
+
+#if BATCH_LANES != 4 && BATCH_LANES != 8 && BATCH_LANES != 16
+#	error "BATCH_LANES needs to be 4, 8, or 16"
+#endif
+
+typedef uint32_t BatchValue;
+typedef BatchValue BatchVec  __attribute__((vector_size(BATCH_LANES * sizeof(BatchValue))));
+typedef int32_t    BatchMask __attribute__((vector_size(BATCH_LANES * sizeof(BatchValue))));
+
+struct BatchS;
+
+// A piece of outstanding work as written to a checkpoint: The value children
+// of the node ops[0..root_ops_index) and everything following the node
+// ops[0..ops_index) inside of that subtree in search order.
+typedef struct TaskS {
+	Element *ops;
+	Index    root_ops_index;
+	Index    ops_index;
+} Task;
+
 struct ThreadManagerS;
+struct NumbersCtxS;
+
+// Called for every found solution. The default prints it.
+typedef void (*SolutionSink)(struct NumbersCtxS *ctx, Number result);
+
+// Called by the worker after it solved a game passed to generate().
+typedef void (*GameDone)(struct NumbersCtxS *ctx);
 
 typedef struct NumbersCtxS {
-	TargetRange            target;
+	// search state, only used by the worker that owns it
+	const TargetSet       *targets;
 	const Number          *numbers;
 	Index                  count;
 	size_t                 used_mask;
 	Index                  used_count;
+	Index                  split_count;
 	Element               *ops;
 	Index                  ops_size;
 	Index                  ops_index;
 	ValElement            *vals;
 	Index                  vals_size;
 	Index                  vals_index;
-	volatile bool          active;
-	volatile bool          alive;
+	Index                  root_ops_index;
+	const Task            *task;
+	// bound pruning, see init_bounds():
+	LogBound              *number_logs;
+	// per number the earlier numbers that are equal to it, all 0 unless
+	// mngr->distinct, see set_equal_masks()
+	size_t                *equal_masks;
+	LogBound               unused_log;
+	LogBound               prune_log;
+	void                  *sink_data;
+	// index of the game in flight among all solvers and lanes, see generate()
+	size_t                 slot;
+	struct BatchS         *batch;
 	struct ThreadManagerS *mngr;
+	// scheduling state, also used by other threads
+	volatile bool          active CACHE_ALIGNED;
+	volatile bool          alive;
+	volatile bool          interrupt;
+	bool                   paused;
 	pthread_t              thread;
 	sem_t                  semaphore;
 } NumbersCtx;
 
 typedef struct ThreadManagerS {
+	// read only while searching
 	Index            number_count;
+	Index            split_count;
 	size_t           thread_count;
-	volatile size_t  available_count;
+	bool             started;
 	NumbersCtx      *solvers;
 	PrintStyle       print_style;
-	pthread_mutex_t  iolock;
-	pthread_mutex_t  worker_lock;
-	sem_t            semaphore;
+	SolutionSink     sink;
+	GameDone         game_done;
 	bool             generate;
+	// solve games passed to generate() in batches, see solve_batch()
+	bool             batch;
+	// try larger numbers and operations closer to a target first, set up
+	// by solve(), see solve_ops_from()
+	bool             guided;
+	Index            guided_order[MAX_NUMBERS];
+	// games passed to generate() count solutions that only differ in which
+	// of equal numbers they use once, see set_equal_masks()
+	bool             distinct;
+	size_t           slot_count;
+	NumbersCtx      *filling;
+	const char      *checkpoint_file;
+	unsigned int     checkpoint_interval;
+	// read by every worker on the fast fork test, written on every fork
+	volatile size_t  available_count CACHE_ALIGNED;
+	pthread_mutex_t  iolock CACHE_ALIGNED;
+	pthread_mutex_t  worker_lock CACHE_ALIGNED;
+	sem_t            semaphore;
+	// checkpoints, guarded by worker_lock:
+	bool             checkpoint_pending;
+	size_t           checkpoint_waiting;
+	pthread_cond_t   checkpoint_cond;
+	sem_t            checkpoint_semaphore;
+	Task            *tasks;
+	size_t           task_count;
+	size_t           task_index;
 } ThreadManager;
 
-static void print_solution_rpn(const NumbersCtx *ctx) {
-//	size_t index = ctx - ctx->mngr->solvers;
-//	printf("(%zu) ", index);
+// Writes value in decimal plus a terminating zero and returns a pointer to
+// the terminating zero.
+static char *format_number(char *buf, Number value) {
+#if NUMBER_BITS == 64
+	return buf + sprintf(buf, "%" PRIu64, value);
+#else
+	char digits[NUMBER_DIGITS];
+	size_t count = 0;
+	do {
+		digits[count ++] = '0' + (char)(value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	while (count > 0) {
+		*buf ++ = digits[-- count];
+	}
+	*buf = 0;
+	return buf;
+#endif
+}
+
+static void fprint_number(FILE *stream, const Number value) {
+	char buf[NUMBER_DIGITS + 1];
+	format_number(buf, value);
+	fputs(buf, stream);
+}
+
+// Parses the decimal digits at the start of str. Returns a pointer to the
+// first character after them, or NULL if there are none or the number
+// doesn't fit into a Number.
+static const char *scan_number(const char *str, Number *value) {
+	Number result = 0;
+	const char *ptr = str;
+	for (; *ptr >= '0' && *ptr <= '9'; ++ ptr) {
+		if (__builtin_mul_overflow(result, 10, &result) ||
+		    __builtin_add_overflow(result, (Number)(*ptr - '0'), &result)) {
+			return NULL;
+		}
+	}
+
+	if (ptr == str) {
+		return NULL;
+	}
+
+	*value = result;
+	return ptr;
+}
+
+static void target_set_create(TargetSet *targets) {
+	*targets = (TargetSet){
+		.ranges   = NULL,
+		.count    = 0,
+		.capacity = 0,
+		.min      = 0,
+		.max      = 0,
+	};
+}
+
+static void target_set_destroy(TargetSet *targets) {
+	free(targets->ranges);
+	targets->ranges   = NULL;
+	targets->count    = 0;
+	targets->capacity = 0;
+}
+
+static void target_set_add(TargetSet *targets, const TargetRange range) {
+	if (range.start > range.end) {
+		char start[NUMBER_DIGITS + 1];
+		char end[NUMBER_DIGITS + 1];
+		format_number(start, range.start);
+		format_number(end, range.end);
+		panicf("target range start is bigger than its end: %s..%s", start, end);
+	}
+
+	if (targets->count == targets->capacity) {
+		const size_t capacity = targets->capacity == 0 ? 8 : targets->capacity * 2;
+		TargetRange *ranges = realloc(targets->ranges, capacity * sizeof(TargetRange));
+		if (!ranges) {
+			panice("allocating target ranges of size %zu", capacity);
+		}
+		targets->ranges   = ranges;
+		targets->capacity = capacity;
+	}
+
+	targets->ranges[targets->count ++] = range;
+}
+
+static int compare_target_ranges(const void *lhs, const void *rhs) {
+	const Number lhs_start = ((const TargetRange*)lhs)->start;
+	const Number rhs_start = ((const TargetRange*)rhs)->start;
+	return lhs_start < rhs_start ? -1 : lhs_start > rhs_start ? 1 : 0;
+}
+
+// Sort the ranges and merge overlapping and adjacent ones. Has to be called
+// after adding ranges and before using the set.
+static void target_set_normalize(TargetSet *targets) {
+	if (targets->count == 0) {
+		panicf("need at least one target");
+	}
+
+	qsort(targets->ranges, targets->count, sizeof(TargetRange), compare_target_ranges);
+
+	size_t count = 1;
+	for (size_t index = 1; index < targets->count; ++ index) {
+		TargetRange *last = &targets->ranges[count - 1];
+		const TargetRange range = targets->ranges[index];
+		if (last->end == (Number)-1 || range.start <= last->end + 1) {
+			if (range.end > last->end) {
+				last->end = range.end;
+			}
+		} else {
+			targets->ranges[count ++] = range;
+		}
+	}
+
+	targets->count = count;
+	targets->min   = targets->ranges[0].start;
+	targets->max   = targets->ranges[count - 1].end;
+}
+
+static inline bool target_set_contains(const TargetSet *targets, const Number value) {
+	if (value < targets->min || value > targets->max) {
+		return false;
+	}
+
+	// find the last range that starts at or before value
+	size_t low  = 0;
+	size_t high = targets->count;
+	while (high - low > 1) {
+		const size_t mid = low + (high - low) / 2;
+		if (targets->ranges[mid].start <= value) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+
+	return targets->ranges[low].end >= value;
+}
+
+// Distance of value to the closest target.
+static Number target_set_distance(const TargetSet *targets, const Number value) {
+	if (value <= targets->min) {
+		return targets->min - value;
+	}
+
+	if (value >= targets->max) {
+		return value - targets->max;
+	}
+
+	size_t low  = 0;
+	size_t high = targets->count;
+	while (high - low > 1) {
+		const size_t mid = low + (high - low) / 2;
+		if (targets->ranges[mid].start <= value) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+
+	if (targets->ranges[low].end >= value) {
+		return 0;
+	}
+
+	// value < max, so there is a next range
+	const Number below = value - targets->ranges[low].end;
+	const Number above = targets->ranges[low + 1].start - value;
+	return below < above ? below : above;
+}
+
+static inline bool target_set_is_single(const TargetSet *targets) {
+	return targets->min == targets->max;
+}
+
+// Bound pruning: For positive integers the result of any operation is
+// a op b <= (a + 1) * (b + 1) - 1, so no expression built on top of the
+// current stack can be bigger than the product of (value + 1) over all stack
+// values and all unused numbers, minus 1. If that is below the smallest
+// target the whole subtree is skipped. The product is tracked as a sum of
+// upper bounds of logarithms: per stack element as a prefix sum in
+// ValElement.log, and for the unused numbers in NumbersCtx.unused_log.
+
+// LOG_TABLE[top] >= log2(top + 1) * LOG_SCALE
+static LogBound LOG_TABLE[256];
+static pthread_once_t LOG_TABLE_ONCE = PTHREAD_ONCE_INIT;
+
+static void log_table_fill() {
+	for (size_t top = 0; top < 256; ++ top) {
+		// + 1 so rounding errors of log2() are on the safe side
+		LOG_TABLE[top] = (LogBound)ceil(log2((double)top + 1.0) * LOG_SCALE) + 1;
+	}
+}
+
+// Thread managers may be created by several threads at once (build/verify).
+static void log_table_init() {
+	const int errnum = pthread_once(&LOG_TABLE_ONCE, log_table_fill);
+	if (errnum != 0) {
+		panicf("initializing log table: %s", strerror(errnum));
+	}
+}
+
+// Upper bound of log2(value + 1): With top being the highest 8 bits of value
+// and shift the number of bits below, value + 1 <= (top + 1) << shift.
+static inline LogBound value_log(const Number value) {
+#if NUMBER_BITS == 128
+	const uint64_t high = (uint64_t)(value >> 64);
+	const int bits = high ? 128 - __builtin_clzll(high) : 64 - __builtin_clzll((uint64_t)value);
+#else
+	const int bits = 64 - __builtin_clzll((unsigned long long)value);
+#endif
+	const int shift = bits > 8 ? bits - 8 : 0;
+	return LOG_TABLE[value >> shift] + (LogBound)shift * LOG_SCALE;
+}
+
+// Any subtree whose bound is at most prune_log can't reach targets->min.
+static LogBound get_prune_log(const TargetSet *targets) {
+	if (targets->min < 2) {
+		return 0;
+	}
+	// - 1 so rounding errors of log2() are on the safe side
+	const double log = floor(log2((double)targets->min) * LOG_SCALE) - 1;
+	return log > 0 ? (LogBound)log : 0;
+}
+
+static void print_target_set(FILE *stream, const TargetSet *targets) {
+	for (size_t index = 0; index < targets->count; ++ index) {
+		const TargetRange *range = &targets->ranges[index];
+		if (index > 0) {
+			fputc(',', stream);
+		}
+		fprint_number(stream, range->start);
+		if (range->start != range->end) {
+			fputs("..", stream);
+			fprint_number(stream, range->end);
+		}
+	}
+}
+
+// A printed element is at most a number or an operator with spaces and
+// parenthesis, plus "RESULT = " and the newline.
+#define SOLUTION_BUFFER_SIZE(ops_size) ((size_t)(ops_size) * (NUMBER_DIGITS + 4) + NUMBER_DIGITS + 12)
+
+static char *format_solution_rpn(const NumbersCtx *ctx, char *buf) {
 	for (Index index = 0; index < ctx->ops_index; ++ index) {
 		if (index > 0) {
-			putchar(' ');
+			*buf ++ = ' ';
 		}
 		switch (ctx->ops[index].op) {
-			case OpVal: printf("%" PRIN, ctx->ops[index].value); break;
-			case OpAdd: putchar('+'); break;
-			case OpSub: putchar('-'); break;
-			case OpMul: putchar('*'); break;
-			case OpDiv: putchar('/'); break;
+			case OpVal: buf = format_number(buf, ctx->ops[index].value); break;
+			case OpAdd: *buf ++ = '+'; break;
+			case OpSub: *buf ++ = '-'; break;
+			case OpMul: *buf ++ = '*'; break;
+			case OpDiv: *buf ++ = '/'; break;
 			default: assert(false);
 		}
 	}
-	putchar('\n');
+	return buf;
 }
 
 static inline void push_op(NumbersCtx *ctx, Op op, Number value) {
 	assert(ctx->ops_index < ctx->ops_size);
 
-	ctx->ops[ctx->ops_index] = (Element){
-		.op    = op,
-		.value = value,
-	};
+	// Not using a compound literal here, because zeroing index made the
+	// whole thing measurably slower.
+	Element *elem = &ctx->ops[ctx->ops_index];
+	elem->op    = op;
+	elem->value = value;
+	++ ctx->ops_index;
+}
+
+static inline void push_val(NumbersCtx *ctx, Index index, Number value) {
+	assert(ctx->ops_index < ctx->ops_size);
+
+	Element *elem = &ctx->ops[ctx->ops_index];
+	elem->op    = OpVal;
+	elem->index = index;
+	elem->value = value;
 	++ ctx->ops_index;
 }
 
@@ -155,18 +539,6 @@ static inline void pop_op(NumbersCtx *ctx) {
 	-- ctx->ops_index;
 }
 
-static Index get_expr_end(const NumbersCtx *ctx, Index index) {
-	const Op op = ctx->ops[index].op;
-	if (op == OpVal) {
-		return index;
-	} else {
-		assert(index > 0);
-		index = get_expr_end(ctx, index - 1);
-		assert(index > 0);
-		return get_expr_end(ctx, index - 1);
-	}
-}
-
 static int get_precedence(Op op) {
 	switch (op) {
 		case OpVal: return 1;
@@ -180,14 +552,17 @@ static int get_precedence(Op op) {
 	}
 }
 
-static void print_expr(const NumbersCtx *ctx, Index index) {
+// starts[index] is the index of the first element of the subexpression that
+// ends at index, so the left hand operand of an operation at index ends at
+// starts[index - 1] - 1.
+static char *format_expr(const NumbersCtx *ctx, const Index starts[], Index index, char *buf) {
 	const Op op = ctx->ops[index].op;
 
 	if (op == OpVal) {
-		printf("%" PRIN, ctx->ops[index].value);
+		buf = format_number(buf, ctx->ops[index].value);
 	} else {
 		assert(index > 0);
-		const Index lhs_index = get_expr_end(ctx, index - 1);
+		const Index lhs_index = starts[index - 1];
 		assert(lhs_index > 0);
 		const int this_precedence = get_precedence(ctx->ops[index].op);
 		const int lhs_precedence  = get_precedence(ctx->ops[lhs_index - 1].op);
@@ -199,70 +574,127 @@ static void print_expr(const NumbersCtx *ctx, Index index) {
 			(ctx->mngr->print_style == PrintParen && ctx->ops[index - 1].op != OpVal);
 
 		if (left_paren) {
-			putchar('(');
+			*buf ++ = '(';
 		}
-		print_expr(ctx, lhs_index - 1);
+		buf = format_expr(ctx, starts, lhs_index - 1, buf);
 		if (left_paren) {
-			putchar(')');
+			*buf ++ = ')';
 		}
 
+		*buf ++ = ' ';
 		switch (op) {
-			case OpAdd: printf(" + "); break;
-			case OpSub: printf(" - "); break;
-			case OpMul: printf(" * "); break;
-			case OpDiv: printf(" / "); break;
+			case OpAdd: *buf ++ = '+'; break;
+			case OpSub: *buf ++ = '-'; break;
+			case OpMul: *buf ++ = '*'; break;
+			case OpDiv: *buf ++ = '/'; break;
 			default: assert(false);
 		}
+		*buf ++ = ' ';
 
 		if (right_paren) {
-			putchar('(');
+			*buf ++ = '(';
 		}
-		print_expr(ctx, index - 1);
+		buf = format_expr(ctx, starts, index - 1, buf);
 		if (right_paren) {
-			putchar(')');
+			*buf ++ = ')';
 		}
 	}
+
+	return buf;
 }
 
-static void print_solution_expr(const NumbersCtx *ctx) {
+static char *format_solution_expr(const NumbersCtx *ctx, char *buf) {
 	Index index = ctx->ops_index;
 	assert(index > 0);
-	print_expr(ctx, index - 1);
-	putchar('\n');
+
+	// One pass over the operations with a stack of subexpression starts,
+	// instead of searching for the start of the left hand operand at every
+	// operation.
+	Index starts[index];
+	Index stack[index];
+	Index stack_index = 0;
+	for (Index op_index = 0; op_index < index; ++ op_index) {
+		if (ctx->ops[op_index].op == OpVal) {
+			starts[op_index] = op_index;
+			stack[stack_index ++] = op_index;
+		} else {
+			// the operands are replaced by the operation, which starts
+			// where its left hand operand starts
+			assert(stack_index >= 2);
+			-- stack_index;
+			starts[op_index] = stack[stack_index - 1];
+		}
+	}
+
+	return format_expr(ctx, starts, index - 1, buf);
 }
 
-static void test_solution(NumbersCtx *ctx) {
-	if (ctx->vals_index == 1) {
-		const Number result = ctx->vals[0].value;
-		if (ctx->target.start <= result && ctx->target.end >= result) {
-			// XXX: For --generate a lot of time is spent waiting for this lock when generating!
-			//      For solving the difference barely matters.
-			// TODO: print into different streams so there is no concurrency?
-			int errnum = pthread_mutex_lock(&ctx->mngr->iolock);
-			if (errnum != 0) {
-				panicf("locking io mutex: %s", strerror(errnum));
-			}
+static char *format_solution(const NumbersCtx *ctx, char *buf) {
+	switch (ctx->mngr->print_style) {
+		case PrintRpn:   return format_solution_rpn(ctx, buf);
+		case PrintExpr:  return format_solution_expr(ctx, buf);
+		case PrintParen: return format_solution_expr(ctx, buf);
+		default:
+			assert(false);
+			return buf;
+	}
+}
 
-			if (ctx->target.start != ctx->target.end) {
-				printf("%" PRIN " = ", result);
-			}
+// Formats the line printed for a solution into buf, which needs to hold
+// SOLUTION_BUFFER_SIZE(ctx->ops_index) bytes. Returns a pointer past the
+// newline.
+static char *format_solution_line(const NumbersCtx *ctx, const Number result, const bool with_result, char *buf) {
+	char *end = buf;
 
-			switch (ctx->mngr->print_style) {
-				case PrintRpn:   print_solution_rpn(ctx);  break;
-				case PrintExpr:  print_solution_expr(ctx); break;
-				case PrintParen: print_solution_expr(ctx); break;
-				default: assert(false);
-			}
+	if (with_result) {
+		end = format_number(end, result);
+		end += sprintf(end, " = ");
+	}
 
-			errnum = pthread_mutex_unlock(&ctx->mngr->iolock);
-			if (errnum != 0) {
-				panicf("unlocking io mutex: %s", strerror(errnum));
-			}
+	end = format_solution(ctx, end);
+	*end ++ = '\n';
+	assert((size_t)(end - buf) <= SOLUTION_BUFFER_SIZE(ctx->ops_index));
+
+	return end;
+}
+
+static void print_solution_with_result(NumbersCtx *ctx, const Number result, const bool with_result) {
+	// The solution is formatted before taking the lock, so only the write
+	// itself is serialized.
+	char buf[SOLUTION_BUFFER_SIZE(ctx->ops_index)];
+	const char *end = format_solution_line(ctx, result, with_result, buf);
+
+	// XXX: For --generate a lot of time is spent waiting for this lock when generating!
+	//      For solving the difference barely matters.
+	// TODO: print into different streams so there is no concurrency?
+	int errnum = pthread_mutex_lock(&ctx->mngr->iolock);
+	if (errnum != 0) {
+		panicf("locking io mutex: %s", strerror(errnum));
+	}
+
+	fwrite(buf, 1, end - buf, stdout);
+
+	errnum = pthread_mutex_unlock(&ctx->mngr->iolock);
+	if (errnum != 0) {
+		panicf("unlocking io mutex: %s", strerror(errnum));
+	}
+}
+
+static void print_solution(NumbersCtx *ctx, const Number result) {
+	print_solution_with_result(ctx, result, !target_set_is_single(ctx->targets));
+}
+
+static void test_solution(NumbersCtx *ctx) {
+	if (ctx->vals_index == 1) {
+		const Number result = ctx->vals[0].value;
+		if (target_set_contains(ctx->targets, result)) {
+			ctx->mngr->sink(ctx, result);
 		}
 	}
 }
 
 static void solve_vals_internal(NumbersCtx *ctx);
+static void solve_vals_internal_guided(NumbersCtx *ctx);
 
 static inline void solve_vals(NumbersCtx *ctx) {
 	if (ctx->used_count < ctx->count) {
@@ -270,205 +702,506 @@ static inline void solve_vals(NumbersCtx *ctx) {
 	}
 }
 
-static void solve_ops(NumbersCtx *ctx) {
-	if (ctx->vals_index > 1) {
-		const ValElement *lhs_val = &ctx->vals[ctx->vals_index - 2];
-		const ValElement *rhs_val = &ctx->vals[ctx->vals_index - 1];
-		const Number lhs = lhs_val->value;
-		const Number rhs = rhs_val->value;
-
-		if (lhs >= rhs) {
-			const Index lhs_ops_index = lhs_val->ops_index;
-			const Index rhs_ops_index = rhs_val->ops_index;
-			const Element *lhs_op = &ctx->ops[lhs_ops_index];
-			const Element *rhs_op = &ctx->ops[rhs_ops_index];
-			Number value = 0;
+static inline void solve_vals_guided(NumbersCtx *ctx) {
+	if (ctx->used_count < ctx->count) {
+		solve_vals_internal_guided(ctx);
+	}
+}
 
-			-- ctx->vals_index;
-			// intermediate results need to be in descending order
-			//   discard  ==    use
-			// X Y Z + +  ==  X Y + Z +
-			// X Y Z - +  ==  Y Z - X +
-			// X Y Z + -  ==  X Y - Z -
-			// X Y Z - -  ==  X Y - Z +  EXCEPT FOR WHEN X - Y WOULD BE NEGATIVE!!
-			//                           Negative intermediate results are forbidden.
-			if (rhs_op->op != OpAdd) {
-				if (rhs_op->op != OpSub && !(
-					(lhs_op->op == OpAdd && ctx->ops[lhs_ops_index - 1].value < rhs) ||
-					(lhs_op->op == OpSub))) {
-					// chains of additions need to be in descending order
-					value = lhs + rhs;
-					ctx->vals[ctx->vals_index - 1] = (ValElement){
-						.value = value,
-						.ops_index = ctx->ops_index,
-					};
-					push_op(ctx, OpAdd, value);
-					test_solution(ctx);
-					solve_ops(ctx);
-					solve_vals(ctx);
-					pop_op(ctx);
+// Operations are tried in this order. Resuming from a checkpoint needs to
+// continue after a given operation.
+typedef enum OpOrderE {
+	OrderAdd,
+	OrderSub,
+	OrderMul,
+	OrderDiv,
+	OrderEnd,
+} OpOrder;
+
+static inline OpOrder get_op_order(Op op) {
+	switch (op) {
+		case OpAdd: return OrderAdd;
+		case OpSub: return OrderSub;
+		case OpMul: return OrderMul;
+		case OpDiv: return OrderDiv;
+		default:
+			assert(false);
+			return OrderEnd;
+	}
+}
+
+static const Op ORDERED_OPS[OrderEnd] = { OpAdd, OpSub, OpMul, OpDiv };
+
+// Returns a bit mask of the operations (1 << OpOrder) that may be applied to
+// the two values on top of the value stack and stores their results in
+// values. Operations whose result would overflow a Number are not legal.
+// Only called if there are at least two values.
+static inline __attribute__((always_inline)) unsigned int get_legal_ops(const NumbersCtx *ctx, Number values[OrderEnd]) {
+	const ValElement *lhs_val = &ctx->vals[ctx->vals_index - 2];
+	const ValElement *rhs_val = &ctx->vals[ctx->vals_index - 1];
+	const Number lhs = lhs_val->value;
+	const Number rhs = rhs_val->value;
+	unsigned int legal = 0;
+
+	if (lhs >= rhs) {
+		const Index lhs_ops_index = lhs_val->ops_index;
+		const Index rhs_ops_index = rhs_val->ops_index;
+		const Element *lhs_op = &ctx->ops[lhs_ops_index];
+		const Element *rhs_op = &ctx->ops[rhs_ops_index];
+
+		// intermediate results need to be in descending order
+		//   discard  ==    use
+		// X Y Z + +  ==  X Y + Z +
+		// X Y Z - +  ==  Y Z - X +
+		// X Y Z + -  ==  X Y - Z -
+		// X Y Z - -  ==  X Y - Z +  EXCEPT FOR WHEN X - Y WOULD BE NEGATIVE!!
+		//                           Negative intermediate results are forbidden.
+		if (rhs_op->op != OpAdd) {
+			if (rhs_op->op != OpSub && !(
+				(lhs_op->op == OpAdd && ctx->ops[lhs_ops_index - 1].value < rhs) ||
+				(lhs_op->op == OpSub))) {
+				// chains of additions need to be in descending order
+				if (!__builtin_add_overflow(lhs, rhs, &values[OrderAdd])) {
+					// results that don't fit into a Number would wrap around
+					legal |= 1 << OrderAdd;
 				}
+			}
 
-				// V = top_op->value = rhs
-				// Z = ctx->ops[ctx->ops_index - 2].value
-				// Y - Z = V
-				// Y = V + Z
-				if ((rhs_op->op != OpSub || lhs < (rhs + ctx->ops[rhs_ops_index - 1].value)) &&
-				    lhs != rhs) {
-					// a intermediate result of 0 is useless
-					if (!(lhs_op->op == OpSub && ctx->ops[lhs_ops_index - 1].value < rhs)) {
-						// chains of subdivisions/additions need to be in descending order
-						value = lhs - rhs;
-						if (value != rhs) {
-							// X - Y = Y is just a roundabout way to write Y
-							ctx->vals[ctx->vals_index - 1] = (ValElement){
-								.value = value,
-								.ops_index = ctx->ops_index,
-							};
-							push_op(ctx, OpSub, value);
-							test_solution(ctx);
-							solve_ops(ctx);
-							solve_vals(ctx);
-							pop_op(ctx);
-						}
+			// V = top_op->value = rhs
+			// Z = ctx->ops[ctx->ops_index - 2].value
+			// Y - Z = V
+			// Y = V + Z
+			if ((rhs_op->op != OpSub || lhs < (rhs + ctx->ops[rhs_ops_index - 1].value)) &&
+			    lhs != rhs) {
+				// a intermediate result of 0 is useless
+				if (!(lhs_op->op == OpSub && ctx->ops[lhs_ops_index - 1].value < rhs)) {
+					// chains of subdivisions/additions need to be in descending order
+					const Number value = lhs - rhs;
+					if (value != rhs) {
+						// X - Y = Y is just a roundabout way to write Y
+						values[OrderSub] = value;
+						legal |= 1 << OrderSub;
 					}
 				}
 			}
+		}
 
-			if (rhs != 1) {
-				// X * 1 and X / 1 are useless
-
-				//   discard  ==    use
-				// X Y Z * *  ==  X Y * Z *
-				// X Y Z / *  ==  Y Z / X *
-				// X Y Z * /  ==  X Y / Z /
-				// X Y Z / /  ==  X Y / Z *
-				if (rhs_op->op != OpMul && rhs_op->op != OpDiv) {
-					if (!((lhs_op->op == OpMul && ctx->ops[lhs_ops_index - 1].value < rhs) ||
-					      (lhs_op->op == OpDiv))) {
-						// chains of multiplications need to be in descending order
-						value = lhs * rhs;
-						ctx->vals[ctx->vals_index - 1] = (ValElement){
-							.value = value,
-							.ops_index = ctx->ops_index,
-						};
-						push_op(ctx, OpMul, value);
-						test_solution(ctx);
-						solve_ops(ctx);
-						solve_vals(ctx);
-						pop_op(ctx);
+		if (rhs != 1) {
+			// X * 1 and X / 1 are useless
+
+			//   discard  ==    use
+			// X Y Z * *  ==  X Y * Z *
+			// X Y Z / *  ==  Y Z / X *
+			// X Y Z * /  ==  X Y / Z /
+			// X Y Z / /  ==  X Y / Z *
+			if (rhs_op->op != OpMul && rhs_op->op != OpDiv) {
+				if (!((lhs_op->op == OpMul && ctx->ops[lhs_ops_index - 1].value < rhs) ||
+				      (lhs_op->op == OpDiv))) {
+					// chains of multiplications need to be in descending order
+					if (!__builtin_mul_overflow(lhs, rhs, &values[OrderMul])) {
+						legal |= 1 << OrderMul;
 					}
+				}
 
-					// Note: Any good compiler should only generate one div instruction for
-					//       the next two lines, since the reminder is just a byproduct of
-					//       the division.
-					value = lhs / rhs;
-					if (lhs % rhs == 0) {
-						// only whole numbers as intermediate results allowed
-						if (!(lhs_op->op == OpDiv && ctx->ops[lhs_ops_index - 1].value < rhs)) {
-							// chains of multiplications/divisions need to be in descending order
-							if (value != rhs) {
-								// X / Y = Y is just a roundabout way to write Y
-								ctx->vals[ctx->vals_index - 1] = (ValElement){
-									.value = value,
-									.ops_index = ctx->ops_index,
-								};
-								push_op(ctx, OpDiv, value);
-								test_solution(ctx);
-								solve_ops(ctx);
-								solve_vals(ctx);
-								pop_op(ctx);
-							}
+				// Note: Any good compiler should only generate one div instruction for
+				//       the next two lines, since the reminder is just a byproduct of
+				//       the division.
+				const Number value = lhs / rhs;
+				if (lhs % rhs == 0) {
+					// only whole numbers as intermediate results allowed
+					if (!(lhs_op->op == OpDiv && ctx->ops[lhs_ops_index - 1].value < rhs)) {
+						// chains of multiplications/divisions need to be in descending order
+						if (value != rhs) {
+							// X / Y = Y is just a roundabout way to write Y
+							values[OrderDiv] = value;
+							legal |= 1 << OrderDiv;
 						}
 					}
 				}
 			}
-			++ ctx->vals_index;
-			ctx->vals[ctx->vals_index - 1] = (ValElement){ .value = rhs, .ops_index = rhs_ops_index };
-			ctx->vals[ctx->vals_index - 2] = (ValElement){ .value = lhs, .ops_index = lhs_ops_index };
 		}
 	}
+
+	return legal;
 }
 
-void solve_vals_internal(NumbersCtx *ctx) {
-	// I thought I could use a max_used_mask instead of tracking used_count,
-	// but it somehow made it slower!?
-	ThreadManager *mngr = ctx->mngr;
-	const size_t used = ctx->used_mask;
-	const Index count = ctx->count;
-	size_t mask = 1;
-	// I thought I can move ++/-- ctx->vals_index and ++/-- ctx->used_count
-	// out of the loop, but it made it somehow slower!?
-	for (Index index = 0; index < count; ++ index) {
-		if ((used & mask) == 0) {
-			ctx->used_mask = used | mask;
-			++ ctx->used_count;
-			const Number number = ctx->numbers[index];
-			assert(ctx->vals_index < ctx->vals_size);
-			ctx->vals[ctx->vals_index] = (ValElement){
-				.value = number,
-				.ops_index = ctx->ops_index,
-			};
-			push_op(ctx, OpVal, number);
-			++ ctx->vals_index;
+// Most nodes of the search tree are leafs, i.e. results of the last operation
+// when all numbers are used. Instead of pushing each of them and calling
+// test_solution(), solve_ops(), and solve_vals() just to find out that there
+// is nothing to do, all candidates are first checked against the target
+// bounds at once. For division lhs is used as an upper bound, so the
+// expensive division and the legality rules are only evaluated if there can
+// be a hit at all, and only hits are pushed for printing.
+static void solve_leaf_ops(NumbersCtx *ctx) {
+	const TargetSet *targets = ctx->targets;
+	const Number lhs = ctx->vals[0].value;
+	const Number rhs = ctx->vals[1].value;
+
+	if (lhs < rhs) {
+		return;
+	}
 
-			test_solution(ctx);
-			solve_ops(ctx);
+	const Number min = targets->min;
+	const Number max = targets->max;
+	// sum and prod may wrap around, but this is only a filter and
+	// get_legal_ops() below checks for overflows
+	const Number sum  = lhs + rhs;
+	const Number diff = lhs - rhs;
+	const Number prod = lhs * rhs;
+
+	// bitwise | instead of || so this compiles without branches
+	const bool maybe_hit =
+		((sum  >= min) & (sum  <= max)) |
+		((diff >= min) & (diff <= max)) |
+		((prod >= min) & (prod <= max)) |
+		(lhs >= min);
+
+	if (!maybe_hit) {
+		return;
+	}
 
-			if (ctx->used_count < ctx->count) {
-				// + 3 proved to be a good balance to reduce thread communication overhead at recursion leafs
-				if (ctx->used_count + 3 < ctx->count && mngr->available_count > 0) { // fast test
-					int errnum = pthread_mutex_lock(&mngr->worker_lock);
-					if (errnum != 0) {
-						panicf("locking worker synchronization mutex: %s", strerror(errnum));
-					}
+	Number values[OrderEnd] = { 0, 0, 0, 0 };
+	const unsigned int legal = get_legal_ops(ctx, values);
 
-					// safe test
-					const bool fork_solver = mngr->available_count > 0;
-					if (fork_solver) {
-						size_t thread_index = 0;
-						for (; thread_index < mngr->thread_count; ++ thread_index) {
-							if (!mngr->solvers[thread_index].active) {
-								break;
-							}
-						}
+	if (legal == 0) {
+		return;
+	}
 
-						assert(thread_index < mngr->thread_count);
+	const ValElement lhs_val = ctx->vals[0];
+	const ValElement rhs_val = ctx->vals[1];
 
-						NumbersCtx *other = &mngr->solvers[thread_index];
+	ctx->vals_index = 1;
+	for (OpOrder order = OrderAdd; order < OrderEnd; ++ order) {
+		if ((legal & (1u << order)) && target_set_contains(targets, values[order])) {
+			ctx->vals[0] = (ValElement){
+				.value = values[order],
+				.ops_index = ctx->ops_index,
+			};
+			push_op(ctx, ORDERED_OPS[order], values[order]);
+			ctx->mngr->sink(ctx, values[order]);
+			pop_op(ctx);
+		}
+	}
+	ctx->vals_index = 2;
+	ctx->vals[0] = lhs_val;
+	ctx->vals[1] = rhs_val;
+}
 
-						other->active = true;
-						mngr->available_count --;
+// One lane per operation, see leaf_parent_ops().
+typedef BatchValue LeafVec  __attribute__((vector_size(OrderEnd * sizeof(BatchValue))));
+typedef int32_t    LeafMask __attribute__((vector_size(OrderEnd * sizeof(BatchValue))));
+
+// One level above the leafs three values are left and no numbers are unused,
+// so every operation on the top two only has leafs as children. The bound
+// check of solve_leaf_ops() is done for the children of all four operations
+// at once, with the results of the operations in the lanes of a vector, and
+// only the operations that might lead to a hit are tried. This needs 32 bit
+// lanes to be of any use (SSE/AVX2 have neither 64 bit products nor unsigned
+// 64 bit compares), so it is only done if all values are below 2^16 and no
+// product can overflow. Otherwise all legal operations are tried.
+static unsigned int leaf_parent_ops(const NumbersCtx *ctx, const Number values[OrderEnd], const unsigned int legal) {
+	if (ctx->vals[0].value > UINT16_MAX) {
+		return legal;
+	}
+	const BatchValue lhs = ctx->vals[0].value;
 
-						errnum = pthread_mutex_unlock(&mngr->worker_lock);
+	LeafVec rhs;
+	for (OpOrder order = OrderAdd; order < OrderEnd; ++ order) {
+		if ((legal & (1u << order)) && values[order] > UINT16_MAX) {
+			return legal;
+		}
+		rhs[order] = values[order];
+	}
 
-						other->used_mask  = ctx->used_mask;
-						other->used_count = ctx->used_count;
-						other->ops_index  = ctx->ops_index;
-						other->vals_index = ctx->vals_index;
+	const TargetSet *targets = ctx->targets;
+	const BatchValue min = targets->min > UINT32_MAX ? UINT32_MAX : targets->min;
+	const BatchValue max = targets->max > UINT32_MAX ? UINT32_MAX : targets->max;
 
-						memcpy(other->ops,  ctx->ops,  sizeof(Element)    * ctx->ops_index);
-						memcpy(other->vals, ctx->vals, sizeof(ValElement) * ctx->vals_index);
+	const LeafVec sum  = lhs + rhs;
+	const LeafVec diff = lhs - rhs;
+	const LeafVec prod = lhs * rhs;
 
-						if (sem_post(&other->semaphore) != 0) {
-							panice("posting to semaphore of worker thread %zu", thread_index);
-						}
-					} else {
-						errnum = pthread_mutex_unlock(&mngr->worker_lock);
-					}
+	const LeafMask maybe_hit = (lhs >= rhs) & (
+		((sum  >= min) & (sum  <= max)) |
+		((diff >= min) & (diff <= max)) |
+		((prod >= min) & (prod <= max)) |
+		((LeafMask){} - (lhs >= min)));
 
-					if (errnum != 0) {
-						panicf("unlocking worker synchronization mutex: %s", strerror(errnum));
-					}
+	unsigned int hits = 0;
+	for (OpOrder order = OrderAdd; order < OrderEnd; ++ order) {
+		if (maybe_hit[order]) {
+			hits |= 1u << order;
+		}
+	}
 
-					if (!fork_solver) {
-						solve_vals_internal(ctx);
-					}
-				} else {
-					solve_vals_internal(ctx);
-				}
-			}
+	return legal & hits;
+}
 
+static void solve_ops(NumbersCtx *ctx);
+static void solve_ops_guided(NumbersCtx *ctx);
+
+// Only ever called with a constant guided, see solve_ops_from().
+static inline __attribute__((always_inline)) void solve_op(NumbersCtx *ctx, const Op op, const Number value, const bool guided) {
+	const Index vals_index = ctx->vals_index - 1;
+	const LogBound log = (vals_index > 0 ? ctx->vals[vals_index - 1].log : 0) + value_log(value);
+	ctx->vals[vals_index] = (ValElement){
+		.value = value,
+		.ops_index = ctx->ops_index,
+		.log = log,
+	};
+	if (log + ctx->unused_log > ctx->prune_log) {
+		push_op(ctx, op, value);
+		test_solution(ctx);
+		if (guided) {
+			solve_ops_guided(ctx);
+			solve_vals_guided(ctx);
+		} else {
+			solve_ops(ctx);
+			solve_vals(ctx);
+		}
+		pop_op(ctx);
+	}
+}
+
+// Only ever called with a constant first from solve_ops(), so there the
+// checks against first are optimized away.
+//
+// Guided (--guided) the same operations are tried, but the ones whose result
+// is closer to a target first, see target_set_distance(). Ties keep the
+// usual order. Together with the larger numbers first order of
+// solve_vals_from() this finds solutions near the target earlier, but the
+// order of operations isn't fixed anymore, so this can't be resumed from a
+// checkpoint.
+static inline __attribute__((always_inline)) void solve_ops_from(NumbersCtx *ctx, const OpOrder first, const bool guided) {
+	if (ctx->vals_index > 1) {
+		if (first == OrderAdd && ctx->vals_index == 2 && ctx->used_count == ctx->count) {
+			solve_leaf_ops(ctx);
+			return;
+		}
+
+		Number values[OrderEnd] = { 0, 0, 0, 0 };
+		unsigned int legal = get_legal_ops(ctx, values) & (~0u << first);
+
+		if (legal != 0 && ctx->vals_index == 3 && ctx->used_count == ctx->count) {
+			legal = leaf_parent_ops(ctx, values, legal);
+		}
+
+		if (legal == 0) {
+			return;
+		}
+
+		const ValElement lhs_val = ctx->vals[ctx->vals_index - 2];
+		const ValElement rhs_val = ctx->vals[ctx->vals_index - 1];
+
+		-- ctx->vals_index;
+		if (guided) {
+			OpOrder orders[OrderEnd];
+			Number distances[OrderEnd];
+			size_t order_count = 0;
+			for (OpOrder order = OrderAdd; order < OrderEnd; ++ order) {
+				if (legal & (1u << order)) {
+					const Number distance = target_set_distance(ctx->targets, values[order]);
+					size_t pos = order_count ++;
+					for (; pos > 0 && distances[pos - 1] > distance; -- pos) {
+						orders[pos]    = orders[pos - 1];
+						distances[pos] = distances[pos - 1];
+					}
+					orders[pos]    = order;
+					distances[pos] = distance;
+				}
+			}
+
+			for (size_t pos = 0; pos < order_count; ++ pos) {
+				solve_op(ctx, ORDERED_OPS[orders[pos]], values[orders[pos]], true);
+			}
+		} else {
+			if (legal & (1u << OrderAdd)) {
+				solve_op(ctx, OpAdd, values[OrderAdd], false);
+			}
+			if (legal & (1u << OrderSub)) {
+				solve_op(ctx, OpSub, values[OrderSub], false);
+			}
+			if (legal & (1u << OrderMul)) {
+				solve_op(ctx, OpMul, values[OrderMul], false);
+			}
+			if (legal & (1u << OrderDiv)) {
+				solve_op(ctx, OpDiv, values[OrderDiv], false);
+			}
+		}
+		++ ctx->vals_index;
+		ctx->vals[ctx->vals_index - 1] = rhs_val;
+		ctx->vals[ctx->vals_index - 2] = lhs_val;
+	}
+}
+
+void solve_ops(NumbersCtx *ctx) {
+	solve_ops_from(ctx, OrderAdd, false);
+}
+
+void solve_ops_guided(NumbersCtx *ctx) {
+	solve_ops_from(ctx, OrderAdd, true);
+}
+
+static void solve_ops_resume(NumbersCtx *ctx, const OpOrder first) {
+	solve_ops_from(ctx, first, false);
+}
+
+static void checkpoint_arrive(ThreadManager *mngr) {
+	assert(mngr->checkpoint_waiting > 0);
+	if (-- mngr->checkpoint_waiting == 0) {
+		if (sem_post(&mngr->checkpoint_semaphore) != 0) {
+			panice("posting to checkpoint semaphore");
+		}
+	}
+}
+
+// Called by a worker when a checkpoint was requested right before it would
+// descend into the value children of a node, at the same place where work is
+// handed off to other threads. At this point the node ops[0..ops_index) and
+// its operation children are done and nothing of its value children is, so
+// the solver state fully describes the outstanding work of this worker.
+static __attribute__((noinline)) void checkpoint_pause(NumbersCtx *ctx) {
+	ThreadManager *mngr = ctx->mngr;
+
+	int errnum = pthread_mutex_lock(&mngr->worker_lock);
+	if (errnum != 0) {
+		panicf("locking worker synchronization mutex: %s", strerror(errnum));
+	}
+
+	ctx->interrupt = false;
+	ctx->paused    = true;
+	checkpoint_arrive(mngr);
+
+	while (mngr->checkpoint_pending) {
+		errnum = pthread_cond_wait(&mngr->checkpoint_cond, &mngr->worker_lock);
+		if (errnum != 0) {
+			panicf("waiting for checkpoint to be written: %s", strerror(errnum));
+		}
+	}
+
+	ctx->paused = false;
+
+	errnum = pthread_mutex_unlock(&mngr->worker_lock);
+	if (errnum != 0) {
+		panicf("unlocking worker synchronization mutex: %s", strerror(errnum));
+	}
+}
+
+// Only ever called with a constant start from solve_vals_internal(), so there
+// it compiles to the same loop as without start. Guided the numbers are tried
+// in the order of mngr->guided_order instead, the largest first.
+static inline __attribute__((always_inline)) void solve_vals_from(NumbersCtx *ctx, const Index start, const bool guided) {
+	// I thought I could use a max_used_mask instead of tracking used_count,
+	// but it somehow made it slower!?
+	ThreadManager *mngr = ctx->mngr;
+	const size_t used = ctx->used_mask;
+	const Index count = ctx->count;
+	size_t mask = (size_t)1 << start;
+	// I thought I can move ++/-- ctx->vals_index and ++/-- ctx->used_count
+	// out of the loop, but it made it somehow slower!?
+	for (Index position = start; position < count; ++ position) {
+		const Index index = guided ? mngr->guided_order[position] : position;
+		if (guided) {
+			mask = (size_t)1 << index;
+		}
+		// of equal numbers only the first unused one, see set_equal_masks()
+		if ((used & mask) == 0 && (ctx->equal_masks[index] & ~used) == 0) {
+			ctx->used_mask = used | mask;
+			++ ctx->used_count;
+			const Number number = ctx->numbers[index];
+			const LogBound number_log = ctx->number_logs[index];
+			const LogBound log = (ctx->vals_index > 0 ? ctx->vals[ctx->vals_index - 1].log : 0) + number_log;
+			assert(ctx->vals_index < ctx->vals_size);
+			ctx->vals[ctx->vals_index] = (ValElement){
+				.value = number,
+				.ops_index = ctx->ops_index,
+				.log = log,
+			};
+			push_val(ctx, index, number);
+			++ ctx->vals_index;
+			ctx->unused_log -= number_log;
+
+			// see value_log()
+			const bool pruned = log + ctx->unused_log <= ctx->prune_log;
+
+			if (!pruned) {
+				test_solution(ctx);
+				if (guided) {
+					solve_ops_guided(ctx);
+				} else {
+					solve_ops(ctx);
+				}
+			}
+
+			if (!pruned && ctx->used_count < ctx->count) {
+				// work is only handed off above split_count used numbers, deeper
+				// subtrees are too small to be worth the thread communication
+				if (ctx->used_count < ctx->split_count && (mngr->available_count > 0 || ctx->interrupt)) { // fast test
+					if (ctx->interrupt) {
+						checkpoint_pause(ctx);
+					}
+
+					int errnum = pthread_mutex_lock(&mngr->worker_lock);
+					if (errnum != 0) {
+						panicf("locking worker synchronization mutex: %s", strerror(errnum));
+					}
+
+					// safe test
+					const bool fork_solver = mngr->available_count > 0 && !mngr->checkpoint_pending;
+					if (fork_solver) {
+						size_t thread_index = 0;
+						for (; thread_index < mngr->thread_count; ++ thread_index) {
+							if (!mngr->solvers[thread_index].active) {
+								break;
+							}
+						}
+
+						assert(thread_index < mngr->thread_count);
+
+						NumbersCtx *other = &mngr->solvers[thread_index];
+
+						other->active = true;
+						mngr->available_count --;
+
+						errnum = pthread_mutex_unlock(&mngr->worker_lock);
+
+						other->used_mask      = ctx->used_mask;
+						other->used_count     = ctx->used_count;
+						other->ops_index      = ctx->ops_index;
+						other->vals_index     = ctx->vals_index;
+						other->root_ops_index = ctx->ops_index;
+						other->task           = NULL;
+						other->unused_log     = ctx->unused_log;
+
+						memcpy(other->ops,  ctx->ops,  sizeof(Element)    * ctx->ops_index);
+						memcpy(other->vals, ctx->vals, sizeof(ValElement) * ctx->vals_index);
+
+						if (sem_post(&other->semaphore) != 0) {
+							panice("posting to semaphore of worker thread %zu", thread_index);
+						}
+					} else {
+						errnum = pthread_mutex_unlock(&mngr->worker_lock);
+					}
+
+					if (errnum != 0) {
+						panicf("unlocking worker synchronization mutex: %s", strerror(errnum));
+					}
+
+					if (!fork_solver) {
+						if (guided) {
+							solve_vals_internal_guided(ctx);
+						} else {
+							solve_vals_internal(ctx);
+						}
+					}
+				} else if (guided) {
+					solve_vals_internal_guided(ctx);
+				} else {
+					solve_vals_internal(ctx);
+				}
+			}
+
+			ctx->unused_log += number_log;
 			-- ctx->vals_index;
 			pop_op(ctx);
 			ctx->used_mask = used;
@@ -478,8 +1211,112 @@ void solve_vals_internal(NumbersCtx *ctx) {
 	}
 }
 
+void solve_vals_internal(NumbersCtx *ctx) {
+	solve_vals_from(ctx, 0, false);
+}
+
+void solve_vals_internal_guided(NumbersCtx *ctx) {
+	solve_vals_from(ctx, 0, true);
+}
+
+// Rebuilds the solver state for the node ops[0..ops_index) of a task.
+// Tasks come from checkpoint files, so they are validated on the way.
+static void replay_task(NumbersCtx *ctx, const Task *task, const Index ops_index) {
+	ctx->used_mask  = 0;
+	ctx->used_count = 0;
+	ctx->ops_index  = 0;
+	ctx->vals_index = 0;
+	ctx->unused_log = 0;
+
+	for (Index index = 0; index < ctx->count; ++ index) {
+		ctx->unused_log += ctx->number_logs[index];
+	}
+
+	for (Index index = 0; index < ops_index; ++ index) {
+		const Element *elem = &task->ops[index];
+		if (elem->op == OpVal) {
+			if (elem->index >= ctx->count || (ctx->used_mask & ((size_t)1 << elem->index)) != 0 || ctx->vals_index >= ctx->vals_size) {
+				panicf("invalid task: number index %" PRII " can't be used at position %" PRII, elem->index, index);
+			}
+			const size_t mask = (size_t)1 << elem->index;
+			const Number number = ctx->numbers[elem->index];
+			const LogBound number_log = ctx->number_logs[elem->index];
+			ctx->vals[ctx->vals_index] = (ValElement){
+				.value = number,
+				.ops_index = ctx->ops_index,
+				.log = (ctx->vals_index > 0 ? ctx->vals[ctx->vals_index - 1].log : 0) + number_log,
+			};
+			++ ctx->vals_index;
+			ctx->unused_log -= number_log;
+			push_val(ctx, elem->index, number);
+			ctx->used_mask |= mask;
+			++ ctx->used_count;
+		} else {
+			if (ctx->vals_index < 2) {
+				panicf("invalid task: operation %c without operands at position %" PRII, elem->op, index);
+			}
+
+			const Number lhs = ctx->vals[ctx->vals_index - 2].value;
+			const Number rhs = ctx->vals[ctx->vals_index - 1].value;
+			Number value = 0;
+			// values are never 0, so rhs can't be either
+			bool allowed = lhs >= rhs;
+
+			switch (elem->op) {
+				case OpAdd: allowed = allowed && !__builtin_add_overflow(lhs, rhs, &value); break;
+				case OpSub: value = lhs - rhs; break;
+				case OpMul: allowed = allowed && !__builtin_mul_overflow(lhs, rhs, &value); break;
+				case OpDiv: allowed = allowed && lhs % rhs == 0; value = lhs / rhs; break;
+				default:
+					panicf("invalid task: illegal operation at position %" PRII, index);
+			}
+
+			if (!allowed || value == 0) {
+				panicf("invalid task: operation %c isn't allowed at position %" PRII, elem->op, index);
+			}
+
+			-- ctx->vals_index;
+			ctx->vals[ctx->vals_index - 1] = (ValElement){
+				.value = value,
+				.ops_index = ctx->ops_index,
+				.log = (ctx->vals_index > 1 ? ctx->vals[ctx->vals_index - 2].log : 0) + value_log(value),
+			};
+			push_op(ctx, elem->op, value);
+		}
+	}
+}
+
+// Does the same work that the original search would have done after reaching
+// the task's node: First the node's value children, then the remaining
+// siblings of every node on the path back up to the task's root.
+static void run_task(NumbersCtx *ctx, const Task *task) {
+	const Index root_ops_index = task->root_ops_index;
+
+	replay_task(ctx, task, task->ops_index);
+	ctx->root_ops_index = root_ops_index;
+	solve_vals(ctx);
+
+	for (Index ops_index = task->ops_index; ops_index > root_ops_index; -- ops_index) {
+		const Element *child = &task->ops[ops_index - 1];
+		replay_task(ctx, task, ops_index - 1);
+
+		if (child->op == OpVal) {
+			if (child->index + 1 < ctx->count) {
+				solve_vals_from(ctx, child->index + 1, false);
+			}
+		} else {
+			const OpOrder next = get_op_order(child->op) + 1;
+			if (next < OrderEnd) {
+				solve_ops_resume(ctx, next);
+			}
+			solve_vals(ctx);
+		}
+	}
+}
+
 static void* worker_proc_solve(void *ptr) {
 	NumbersCtx *ctx = (NumbersCtx*)ptr;
+	ThreadManager *mngr = ctx->mngr;
 	for (;;) {
 		if (sem_wait(&ctx->semaphore) != 0) {
 			panice("worker waiting for work");
@@ -489,24 +1326,53 @@ static void* worker_proc_solve(void *ptr) {
 			break;
 		}
 
-		solve_vals(ctx);
+		if (ctx->task) {
+			run_task(ctx, ctx->task);
+		} else if (mngr->guided) {
+			solve_vals_guided(ctx);
+		} else {
+			solve_vals(ctx);
+		}
 
-		int errnum = pthread_mutex_lock(&ctx->mngr->worker_lock);
+		int errnum = pthread_mutex_lock(&mngr->worker_lock);
 		if (errnum != 0) {
 			panicf("locking worker synchronization mutex: %s", strerror(errnum));
 		}
 
+		// tasks of a resumed checkpoint that no worker has picked up yet
+		while (mngr->task_index < mngr->task_count) {
+			ctx->task = &mngr->tasks[mngr->task_index ++];
+
+			errnum = pthread_mutex_unlock(&mngr->worker_lock);
+			if (errnum != 0) {
+				panicf("unlocking worker synchronization mutex: %s", strerror(errnum));
+			}
+
+			run_task(ctx, ctx->task);
+
+			errnum = pthread_mutex_lock(&mngr->worker_lock);
+			if (errnum != 0) {
+				panicf("locking worker synchronization mutex: %s", strerror(errnum));
+			}
+		}
+
+		ctx->task   = NULL;
 		ctx->active = false;
-		assert(ctx->mngr->available_count < ctx->mngr->thread_count);
-		const size_t available_count = ++ ctx->mngr->available_count;
+		if (ctx->interrupt) {
+			// finished before reaching a checkpoint pause, so nothing to record
+			ctx->interrupt = false;
+			checkpoint_arrive(mngr);
+		}
+		assert(mngr->available_count < mngr->thread_count);
+		const size_t available_count = ++ mngr->available_count;
 
-		errnum = pthread_mutex_unlock(&ctx->mngr->worker_lock);
+		errnum = pthread_mutex_unlock(&mngr->worker_lock);
 		if (errnum != 0) {
 			panicf("unlocking worker synchronization mutex: %s", strerror(errnum));
 		}
 
-		if (available_count == ctx->mngr->thread_count) {
-			if (sem_post(&ctx->mngr->semaphore) != 0) {
+		if (available_count == mngr->thread_count) {
+			if (sem_post(&mngr->semaphore) != 0) {
 				panice("posting to thread manager semaphore");
 			}
 		}
@@ -515,355 +1381,2879 @@ static void* worker_proc_solve(void *ptr) {
 	return NULL;
 }
 
-static void* worker_proc_generate(void *ptr) {
-	NumbersCtx *ctx = (NumbersCtx*)ptr;
-	for (;;) {
-		if (sem_wait(&ctx->semaphore) != 0) {
-			panice("worker waiting for work");
+// Zeroed memory in whole cache lines, so per-thread arrays of different
+// workers never share a line.
+static void *cache_aligned_calloc(size_t count, size_t size) {
+	const size_t bytes = (count * size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+	void *ptr = aligned_alloc(CACHE_LINE_SIZE, bytes);
+	if (ptr) {
+		memset(ptr, 0, bytes);
+	}
+	return ptr;
+}
+
+// Batches: With --generate a lot of games with the same count of numbers are
+// solved. A batch solves BATCH_LANES of them in lockstep, one per lane of
+// a vector: All lanes walk the same sequence of pushed numbers (by index)
+// and operations, and every lane has its own values. The legality rules of
+// get_legal_ops() are evaluated for all lanes at once into masks of lanes
+// for which an operation is legal, and a subtree is only visited if it is
+// legal for any lane. Only hits leave the vectors: the solution of that lane
+// is copied into its own NumbersCtx, which is passed to the sink.
+//
+// Values are 32 bit, so only games whose values can't get bigger than that
+// are batched (see batch_fits()). For those nothing can overflow. Bound
+// pruning isn't used, targets of the standard game are small anyway. The
+// sink can still end the search of a lane by setting its prune_log to the
+// maximum, like for the normal search. Vectors are passed by pointer,
+// because passed by value their ABI would depend on the instruction set the
+// file is compiled for.
+
+typedef struct BatchS {
+	size_t      lane_count;
+	// lanes that still search
+	BatchMask   alive;
+	// the bounds of the targets, clamped to BatchValue
+	BatchValue  min;
+	BatchValue  max;
+	// per number, per element of the solver's ops, and per value on the stack
+	BatchVec   *numbers;
+	BatchVec   *values;
+	BatchVec   *vals;
+	NumbersCtx *lanes;
+} Batch;
+
+// No expression can be bigger than the product of (number + 1) minus 1,
+// see value_log().
+static bool batch_fits(const Number numbers[], const Index count) {
+	Number bound = 1;
+	for (Index index = 0; index < count; ++ index) {
+		if (__builtin_mul_overflow(bound, numbers[index] + 1, &bound)) {
+			return false;
 		}
+	}
+	return bound - 1 <= (Number)UINT32_MAX;
+}
 
-		if (!ctx->alive) {
-			break;
+static inline bool batch_any(const BatchMask *mask) {
+	typedef uint64_t BatchWords __attribute__((vector_size(sizeof(BatchMask))));
+	const BatchWords words = (BatchWords)*mask;
+	uint64_t any = 0;
+	for (size_t index = 0; index < sizeof(BatchWords) / sizeof(uint64_t); ++ index) {
+		any |= words[index];
+	}
+	return any != 0;
+}
+
+// Passes the hits among the lanes in mask to the sink.
+static void batch_record(NumbersCtx *ctx, Batch *batch, const BatchMask *mask, const BatchVec *values) {
+	for (size_t lane_index = 0; lane_index < BATCH_LANES; ++ lane_index) {
+		const Number value = (*values)[lane_index];
+		if (!(*mask)[lane_index] || !target_set_contains(ctx->targets, value)) {
+			continue;
 		}
 
-		solve_vals(ctx);
+		NumbersCtx *lane = &batch->lanes[lane_index];
+		for (Index index = 0; index < ctx->ops_index; ++ index) {
+			lane->ops[index] = (Element){
+				.op    = ctx->ops[index].op,
+				.index = ctx->ops[index].index,
+				.value = batch->values[index][lane_index],
+			};
+		}
+		lane->ops_index = ctx->ops_index;
+		ctx->mngr->sink(lane, value);
 
-		ctx->active = false;
+		if (lane->prune_log == ~(LogBound)0) {
+			batch->alive[lane_index] = 0;
+		}
+	}
+}
 
-		if (sem_post(&ctx->mngr->semaphore) != 0) {
-			panice("posting to thread manager semaphore");
+static inline void batch_test(NumbersCtx *ctx, Batch *batch, const BatchMask *live) {
+	if (ctx->vals_index == 1) {
+		const BatchVec value = batch->vals[0];
+		const BatchMask hit = *live & batch->alive & (value >= batch->min) & (value <= batch->max);
+		if (batch_any(&hit)) {
+			batch_record(ctx, batch, &hit, &value);
 		}
 	}
+}
 
-	return NULL;
+static void batch_ops(NumbersCtx *ctx, Batch *batch, const BatchMask *live);
+static void batch_vals(NumbersCtx *ctx, Batch *batch, const BatchMask *all_live);
+
+static void batch_op(NumbersCtx *ctx, Batch *batch, const BatchMask *live, const Op op, const BatchVec *value) {
+	const Index vals_index = ctx->vals_index - 1;
+	ctx->vals[vals_index].ops_index = ctx->ops_index;
+	batch->vals[vals_index] = *value;
+	batch->values[ctx->ops_index] = *value;
+	push_op(ctx, op, 0);
+	batch_test(ctx, batch, live);
+	batch_ops(ctx, batch, live);
+	batch_vals(ctx, batch, live);
+	pop_op(ctx);
 }
 
-static void thread_manager_create(ThreadManager *mngr, const Index count, const size_t threads, const PrintStyle print_style, bool generate);
-static void thread_manager_destroy(ThreadManager *mngr);
+// Pushes the operation for the hits of the last operation of a game.
+static void batch_leaf_op(NumbersCtx *ctx, Batch *batch, const BatchMask *hit, const Op op, const BatchVec *value) {
+	batch->values[ctx->ops_index] = *value;
+	push_op(ctx, op, 0);
+	batch_record(ctx, batch, hit, value);
+	pop_op(ctx);
+}
 
-void solve(ThreadManager *mngr, const TargetRange target, const Number numbers[]) {
-	assert(mngr->available_count == mngr->thread_count);
+// The same rules as get_legal_ops(), see there.
+void batch_ops(NumbersCtx *ctx, Batch *batch, const BatchMask *live) {
+	if (ctx->vals_index < 2) {
+		return;
+	}
 
-	for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
-		NumbersCtx *solver = &mngr->solvers[thread_index];
-		assert(!solver->active);
+	const Index lhs_ops_index = ctx->vals[ctx->vals_index - 2].ops_index;
+	const Index rhs_ops_index = ctx->vals[ctx->vals_index - 1].ops_index;
+	const Op lhs_op = ctx->ops[lhs_ops_index].op;
+	const Op rhs_op = ctx->ops[rhs_ops_index].op;
+	const BatchVec lhs = batch->vals[ctx->vals_index - 2];
+	const BatchVec rhs = batch->vals[ctx->vals_index - 1];
+	const BatchMask ordered = *live & batch->alive & (lhs >= rhs);
 
-		solver->target     = target;
-		solver->numbers    = numbers;
-		solver->used_mask  = 0,
-		solver->used_count = 0,
-		solver->ops_index  = 0;
-		solver->vals_index = 0;
+	if (!batch_any(&ordered)) {
+		return;
 	}
 
-	mngr->solvers[0].active = true;
-	mngr->available_count --;
+	// the right hand operand of the operations that made lhs and rhs
+	const BatchVec zero = { 0 };
+	const BatchVec lhs_prev = lhs_op != OpVal ? batch->values[lhs_ops_index - 1] : zero;
+	const BatchVec rhs_prev = rhs_op != OpVal ? batch->values[rhs_ops_index - 1] : zero;
+	const BatchVec sum  = lhs + rhs;
+	const BatchVec diff = lhs - rhs;
+	const BatchVec prod = lhs * rhs;
+
+	BatchMask add = { 0 };
+	BatchMask sub = { 0 };
+	BatchMask mul = { 0 };
+	BatchMask div = { 0 };
+
+	if (rhs_op != OpAdd) {
+		if (rhs_op != OpSub && lhs_op != OpSub) {
+			add = lhs_op == OpAdd ? ordered & (lhs_prev >= rhs) : ordered;
+		}
+
+		sub = ordered & (lhs != rhs) & (diff != rhs);
+		if (rhs_op == OpSub) {
+			sub &= lhs < rhs + rhs_prev;
+		}
+		if (lhs_op == OpSub) {
+			sub &= lhs_prev >= rhs;
+		}
+	}
 
-	if (sem_post(&mngr->solvers[0].semaphore) != 0) {
-		panice("posting to semaphore of worker thread 0");
+	if (rhs_op != OpMul && rhs_op != OpDiv) {
+		const BatchMask not_one = ordered & (rhs != 1);
+		if (lhs_op != OpDiv) {
+			mul = lhs_op == OpMul ? not_one & (lhs_prev >= rhs) : not_one;
+		}
+		div = lhs_op == OpDiv ? not_one & (lhs_prev >= rhs) : not_one;
 	}
 
-	if (sem_wait(&mngr->semaphore) != 0) {
-		panice("waiting on thread manager semaphore");
+	const bool leaf = ctx->used_count == ctx->count && ctx->vals_index == 2;
+	const BatchValue min = batch->min;
+	const BatchValue max = batch->max;
+	if (leaf) {
+		// like solve_leaf_ops(): only the hits matter
+		add &= (sum  >= min) & (sum  <= max);
+		sub &= (diff >= min) & (diff <= max);
+		mul &= (prod >= min) & (prod <= max);
+		div &= lhs >= min;
 	}
-}
 
-void generate(ThreadManager *mngr, const TargetRange target, const Number numbers[]) {
-	assert(mngr->available_count == 0);
+	// there is no vector division, but only few lanes are left here
+	BatchVec quot = { 0 };
+	if (batch_any(&div)) {
+		for (size_t lane_index = 0; lane_index < BATCH_LANES; ++ lane_index) {
+			if (div[lane_index]) {
+				const BatchValue value = lhs[lane_index] / rhs[lane_index];
+				if (lhs[lane_index] % rhs[lane_index] != 0 || value == rhs[lane_index]) {
+					div[lane_index] = 0;
+				}
+				quot[lane_index] = value;
+			}
+		}
+		if (leaf) {
+			div &= (quot >= min) & (quot <= max);
+		}
+	}
 
-	size_t thread_index = 0;
+	const ValElement lhs_val = ctx->vals[ctx->vals_index - 2];
+	const ValElement rhs_val = ctx->vals[ctx->vals_index - 1];
 
-	for (;;) {
-		for (thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
-			NumbersCtx *solver = &mngr->solvers[thread_index];
+	-- ctx->vals_index;
+	if (leaf) {
+		if (batch_any(&add)) batch_leaf_op(ctx, batch, &add, OpAdd, &sum);
+		if (batch_any(&sub)) batch_leaf_op(ctx, batch, &sub, OpSub, &diff);
+		if (batch_any(&mul)) batch_leaf_op(ctx, batch, &mul, OpMul, &prod);
+		if (batch_any(&div)) batch_leaf_op(ctx, batch, &div, OpDiv, &quot);
+	} else {
+		if (batch_any(&add)) batch_op(ctx, batch, &add, OpAdd, &sum);
+		if (batch_any(&sub)) batch_op(ctx, batch, &sub, OpSub, &diff);
+		if (batch_any(&mul)) batch_op(ctx, batch, &mul, OpMul, &prod);
+		if (batch_any(&div)) batch_op(ctx, batch, &div, OpDiv, &quot);
+	}
+	++ ctx->vals_index;
+	batch->vals[ctx->vals_index - 1] = rhs;
+	batch->vals[ctx->vals_index - 2] = lhs;
+	ctx->vals[ctx->vals_index - 1] = rhs_val;
+	ctx->vals[ctx->vals_index - 2] = lhs_val;
+}
 
-			if (!solver->active) {
-				break;
-			}
+void batch_vals(NumbersCtx *ctx, Batch *batch, const BatchMask *all_live) {
+	for (Index index = 0; index < ctx->count; ++ index) {
+		const size_t mask = (size_t)1 << index;
+		if (ctx->used_mask & mask) {
+			continue;
 		}
 
-		if (thread_index < mngr->thread_count) {
-			NumbersCtx *solver = &mngr->solvers[thread_index];
-			solver->target     = target;
-			solver->used_mask  = 0,
-			solver->used_count = 0,
-			solver->ops_index  = 0;
-			solver->vals_index = 0;
-			solver->active     = true;
-
-			memcpy((void*) solver->numbers, numbers, mngr->number_count * sizeof(Number));
-			break;
-		} else {
-			if (sem_wait(&mngr->semaphore) != 0) {
-				panice("waiting on thread manager semaphore");
+		// like set_equal_masks(), but the numbers differ per lane
+		BatchMask lanes = *all_live;
+		if (ctx->mngr->distinct) {
+			for (Index other = 0; other < index; ++ other) {
+				if (!(ctx->used_mask & ((size_t)1 << other))) {
+					lanes &= batch->numbers[other] != batch->numbers[index];
+				}
+			}
+
+			if (!batch_any(&lanes)) {
+				continue;
 			}
 		}
-	}
+		const BatchMask *live = &lanes;
+
+		ctx->used_mask |= mask;
+		++ ctx->used_count;
+		ctx->vals[ctx->vals_index].ops_index = ctx->ops_index;
+		batch->vals[ctx->vals_index] = batch->numbers[index];
+		batch->values[ctx->ops_index] = batch->numbers[index];
+		push_val(ctx, index, 0);
+		++ ctx->vals_index;
+
+		batch_test(ctx, batch, live);
+		batch_ops(ctx, batch, live);
+		if (ctx->used_count < ctx->count) {
+			batch_vals(ctx, batch, live);
+		}
 
-	if (sem_post(&mngr->solvers[thread_index].semaphore) != 0) {
-		panice("posting to semaphore of worker thread 0");
+		pop_op(ctx);
+		-- ctx->vals_index;
+		-- ctx->used_count;
+		ctx->used_mask &= ~mask;
 	}
 }
 
-void thread_manager_create(ThreadManager *mngr, const Index count, const size_t threads, const PrintStyle print_style, bool generate) {
-	if (count == 0) {
-		panicf("need at least one number");
+// Solves the games in the lanes of the batch of ctx.
+static void solve_batch(NumbersCtx *ctx) {
+	Batch *batch = ctx->batch;
+
+	for (Index index = 0; index < ctx->count; ++ index) {
+		for (size_t lane_index = 0; lane_index < BATCH_LANES; ++ lane_index) {
+			// unused lanes get numbers too, but they are not alive
+			const NumbersCtx *lane = &batch->lanes[lane_index < batch->lane_count ? lane_index : 0];
+			batch->numbers[index][lane_index] = (BatchValue)lane->numbers[index];
+		}
 	}
 
-	if (threads == 0) {
-		panicf("need at least one thread");
+	for (size_t lane_index = 0; lane_index < BATCH_LANES; ++ lane_index) {
+		batch->alive[lane_index] = lane_index < batch->lane_count ? -1 : 0;
 	}
 
+	// the targets of all lanes are the same, see generate()
+	const TargetSet *targets = ctx->targets;
+	batch->min = targets->min > UINT32_MAX ? UINT32_MAX : (BatchValue)targets->min;
+	batch->max = targets->max > UINT32_MAX ? UINT32_MAX : (BatchValue)targets->max;
+	if (targets->min > UINT32_MAX) {
+		// nothing can hit
+		batch->alive = (BatchMask){ 0 };
+	}
+
+	ctx->used_mask  = 0;
+	ctx->used_count = 0;
+	ctx->ops_index  = 0;
+	ctx->vals_index = 0;
+
+	const BatchMask live = batch->alive;
+	batch_vals(ctx, batch, &live);
+
+	if (ctx->mngr->game_done) {
+		for (size_t lane_index = 0; lane_index < batch->lane_count; ++ lane_index) {
+			ctx->mngr->game_done(&batch->lanes[lane_index]);
+		}
+	}
+	batch->lane_count = 0;
+}
+
+// The lanes get slots first_slot and following.
+static Batch *batch_create(ThreadManager *mngr, const Index count, const size_t first_slot) {
 	const Index ops_size = count + count - 1;
-	const Index vals_size = count;
 
-	NumbersCtx *solvers = calloc(threads, sizeof(NumbersCtx));
-	if (!solvers) {
-		panice("allocating contexts %zu", threads);
+	Batch *batch = cache_aligned_calloc(1, sizeof(Batch));
+	if (!batch) {
+		panice("allocating batch");
 	}
 
-	*mngr = (ThreadManager) {
-		.number_count    = count,
-		.thread_count    = threads,
-		.available_count = generate ? 0 : threads,
-		.solvers         = solvers,
-		.print_style     = print_style,
-		.iolock          = PTHREAD_MUTEX_INITIALIZER,
-		.worker_lock     = PTHREAD_MUTEX_INITIALIZER,
-		.generate        = generate,
-	};
+	batch->numbers = cache_aligned_calloc(count, sizeof(BatchVec));
+	batch->values  = cache_aligned_calloc(ops_size, sizeof(BatchVec));
+	batch->vals    = cache_aligned_calloc(count, sizeof(BatchVec));
+	batch->lanes   = cache_aligned_calloc(BATCH_LANES, sizeof(NumbersCtx));
+	if (!batch->numbers || !batch->values || !batch->vals || !batch->lanes) {
+		panice("allocating batch of %" PRII " numbers", count);
+	}
 
-	if (sem_init(&mngr->semaphore, 0, 0) != 0) {
-		panice("initializing semaphore of thread manager");
+	for (size_t lane_index = 0; lane_index < BATCH_LANES; ++ lane_index) {
+		Element *ops = cache_aligned_calloc(ops_size, sizeof(Element));
+		Number *numbers = cache_aligned_calloc(count, sizeof(Number));
+		if (!ops || !numbers) {
+			panice("allocating lane of %" PRII " numbers", count);
+		}
+
+		// only what the sinks and game_done() need
+		batch->lanes[lane_index] = (NumbersCtx){
+			.numbers  = numbers,
+			.count    = count,
+			.ops      = ops,
+			.ops_size = ops_size,
+			.slot     = first_slot + lane_index,
+			.mngr     = mngr,
+		};
 	}
 
-	void* (*worker_proc)(void *) = generate ? &worker_proc_generate : &worker_proc_solve;
+	return batch;
+}
 
-	for (size_t thread_index = 0; thread_index < threads; ++ thread_index) {
-		Element *ops = calloc(ops_size, sizeof(Element));
-		if (!ops) {
-			panice("allocating operand stack of size %u", ops_size);
+static void batch_destroy(Batch *batch) {
+	for (size_t lane_index = 0; lane_index < BATCH_LANES; ++ lane_index) {
+		free(batch->lanes[lane_index].ops);
+		free((void*)batch->lanes[lane_index].numbers);
+	}
+	free(batch->lanes);
+	free(batch->numbers);
+	free(batch->values);
+	free(batch->vals);
+	free(batch);
+}
+
+// Swapping two equal numbers gives the same solution again. To count each
+// solution once, a number is only pushed if all earlier numbers equal to it
+// are already used. So equal numbers are always used in the order they are
+// given, and every solution is found with exactly one assignment of them.
+static void set_equal_masks(NumbersCtx *ctx) {
+	for (Index index = 0; index < ctx->count; ++ index) {
+		size_t equal_mask = 0;
+		for (Index other = 0; other < index; ++ other) {
+			if (ctx->numbers[other] == ctx->numbers[index]) {
+				equal_mask |= (size_t)1 << other;
+			}
 		}
+		ctx->equal_masks[index] = equal_mask;
+	}
+}
 
-		ValElement *vals = calloc(vals_size, sizeof(ValElement));
-		if (!vals) {
-			panice("allocating value stack of size %u", vals_size);
+static void* worker_proc_generate(void *ptr) {
+	NumbersCtx *ctx = (NumbersCtx*)ptr;
+	for (;;) {
+		if (sem_wait(&ctx->semaphore) != 0) {
+			panice("worker waiting for work");
 		}
 
-		NumbersCtx *solver = &solvers[thread_index];
+		if (!ctx->alive) {
+			break;
+		}
 
-		*solver = (NumbersCtx){
-			.target      = { .start = 0, .end = 0 },
-			.numbers     = NULL,
-			.count       = count,
-			.used_mask   = 0,
-			.used_count  = 0,
-			.ops         = ops,
-			.ops_size    = ops_size,
-			.ops_index   = 0,
-			.vals        = vals,
-			.vals_size   = vals_size,
-			.vals_index  = 0,
-			.active      = false,
-			.alive       = true,
-			.mngr        = mngr,
+		if (ctx->batch && ctx->batch->lane_count > 0) {
+			solve_batch(ctx);
+		} else {
+			if (ctx->mngr->distinct) {
+				set_equal_masks(ctx);
+			}
+
+			solve_vals(ctx);
+
+			if (ctx->mngr->game_done) {
+				ctx->mngr->game_done(ctx);
+			}
+		}
+
+		ctx->active = false;
+
+		if (sem_post(&ctx->mngr->semaphore) != 0) {
+			panice("posting to thread manager semaphore");
+		}
+	}
+
+	return NULL;
+}
+
+static void thread_manager_create(ThreadManager *mngr, const Index count, const size_t threads, const PrintStyle print_style, bool generate);
+static void thread_manager_start(ThreadManager *mngr);
+static void thread_manager_destroy(ThreadManager *mngr);
+
+// Single threaded without checkpoints there is nobody to hand work to or to
+// pause for, so the search runs right on the calling thread. Small games are
+// then done before a worker thread would even have been started.
+static void solve_inline(ThreadManager *mngr) {
+	NumbersCtx *solver = &mngr->solvers[0];
+	solver->active = true;
+	mngr->available_count --;
+
+	if (mngr->task_count == 0) {
+		if (mngr->guided) {
+			solve_vals_guided(solver);
+		} else {
+			solve_vals(solver);
+		}
+	} else {
+		while (mngr->task_index < mngr->task_count) {
+			solver->task = &mngr->tasks[mngr->task_index ++];
+			run_task(solver, solver->task);
+		}
+		solver->task = NULL;
+	}
+
+	solver->active = false;
+	mngr->available_count ++;
+}
+
+#define CHECKPOINT_MAGIC   "numbers-checkpoint"
+#define CHECKPOINT_VERSION 1
+
+static void write_task(FILE *fp, const Element ops[], const Index root_ops_index, const Index ops_index) {
+	fprintf(fp, "task %" PRII " %" PRII, root_ops_index, ops_index);
+	for (Index index = 0; index < ops_index; ++ index) {
+		if (ops[index].op == OpVal) {
+			fprintf(fp, " %" PRII, ops[index].index);
+		} else {
+			fprintf(fp, " %c", ops[index].op);
+		}
+	}
+	fputc('\n', fp);
+}
+
+// Only called while all workers are paused or idle.
+static void write_checkpoint(ThreadManager *mngr) {
+	const char *filename = mngr->checkpoint_file;
+	const NumbersCtx *first = &mngr->solvers[0];
+
+	// everything printed so far is covered by the checkpoint
+	if (fflush(stdout) != 0) {
+		panice("flushing standard output");
+	}
+	const off_t output_offset = ftello(stdout);
+	// so a resume only truncates this file, see restore_output_offset()
+	struct stat output_info;
+	const bool output_is_file = fstat(fileno(stdout), &output_info) == 0 && S_ISREG(output_info.st_mode);
+
+	const size_t filename_len = strlen(filename);
+	char *tmp_filename = malloc(filename_len + 5);
+	if (!tmp_filename) {
+		panice("allocating file name");
+	}
+	memcpy(tmp_filename, filename, filename_len);
+	memcpy(tmp_filename + filename_len, ".tmp", 5);
+
+	FILE *fp = fopen(tmp_filename, "w");
+	if (!fp) {
+		panice("opening checkpoint file: %s", tmp_filename);
+	}
+
+	fprintf(fp, "%s %d\n", CHECKPOINT_MAGIC, CHECKPOINT_VERSION);
+	fprintf(fp, "targets ");
+	print_target_set(fp, first->targets);
+	fprintf(fp, "\nnumbers");
+	for (Index index = 0; index < first->count; ++ index) {
+		fputc(' ', fp);
+		fprint_number(fp, first->numbers[index]);
+	}
+	if (output_is_file && output_offset >= 0) {
+		fprintf(fp, "\noutput %lld %llu %llu\n", (long long)output_offset,
+			(unsigned long long)output_info.st_dev, (unsigned long long)output_info.st_ino);
+	} else {
+		fprintf(fp, "\noutput -1\n");
+	}
+
+	for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
+		const NumbersCtx *solver = &mngr->solvers[thread_index];
+		if (solver->paused) {
+			write_task(fp, solver->ops, solver->root_ops_index, solver->ops_index);
+		}
+	}
+
+	for (size_t task_index = mngr->task_index; task_index < mngr->task_count; ++ task_index) {
+		const Task *task = &mngr->tasks[task_index];
+		write_task(fp, task->ops, task->root_ops_index, task->ops_index);
+	}
+
+	fprintf(fp, "end\n");
+
+	if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+		panice("writing checkpoint file: %s", tmp_filename);
+	}
+
+	if (fclose(fp) != 0) {
+		panice("closing checkpoint file: %s", tmp_filename);
+	}
+
+	if (rename(tmp_filename, filename) != 0) {
+		panice("renaming checkpoint file %s to %s", tmp_filename, filename);
+	}
+
+	free(tmp_filename);
+}
+
+// Pauses all active workers at their next checkpoint pause, writes their
+// state and any not yet started tasks, and lets them continue.
+static void checkpoint(ThreadManager *mngr) {
+	int errnum = pthread_mutex_lock(&mngr->worker_lock);
+	if (errnum != 0) {
+		panicf("locking worker synchronization mutex: %s", strerror(errnum));
+	}
+
+	size_t waiting = 0;
+	for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
+		NumbersCtx *solver = &mngr->solvers[thread_index];
+		if (solver->active) {
+			solver->interrupt = true;
+			++ waiting;
+		}
+	}
+	mngr->checkpoint_pending = waiting > 0;
+	mngr->checkpoint_waiting = waiting;
+
+	errnum = pthread_mutex_unlock(&mngr->worker_lock);
+	if (errnum != 0) {
+		panicf("unlocking worker synchronization mutex: %s", strerror(errnum));
+	}
+
+	if (waiting == 0) {
+		return;
+	}
+
+	while (sem_wait(&mngr->checkpoint_semaphore) != 0) {
+		if (errno != EINTR) {
+			panice("waiting on checkpoint semaphore");
+		}
+	}
+
+	errnum = pthread_mutex_lock(&mngr->worker_lock);
+	if (errnum != 0) {
+		panicf("locking worker synchronization mutex: %s", strerror(errnum));
+	}
+
+	write_checkpoint(mngr);
+
+	mngr->checkpoint_pending = false;
+	errnum = pthread_cond_broadcast(&mngr->checkpoint_cond);
+	if (errnum != 0) {
+		panicf("waking up workers after checkpoint: %s", strerror(errnum));
+	}
+
+	errnum = pthread_mutex_unlock(&mngr->worker_lock);
+	if (errnum != 0) {
+		panicf("unlocking worker synchronization mutex: %s", strerror(errnum));
+	}
+}
+
+static void wait_for_workers(ThreadManager *mngr) {
+	if (!mngr->checkpoint_file) {
+		if (sem_wait(&mngr->semaphore) != 0) {
+			panice("waiting on thread manager semaphore");
+		}
+		return;
+	}
+
+	bool done = false;
+	while (!done) {
+		struct timespec deadline;
+		if (clock_gettime(CLOCK_REALTIME, &deadline) != 0) {
+			panice("getting current time");
+		}
+		deadline.tv_sec += mngr->checkpoint_interval;
+
+		for (;;) {
+			if (sem_timedwait(&mngr->semaphore, &deadline) == 0) {
+				done = true;
+				break;
+			} else if (errno == ETIMEDOUT) {
+				checkpoint(mngr);
+				break;
+			} else if (errno != EINTR) {
+				panice("waiting on thread manager semaphore");
+			}
+		}
+	}
+
+	// finished, nothing left to resume
+	if (unlink(mngr->checkpoint_file) != 0 && errno != ENOENT) {
+		panice("removing checkpoint file: %s", mngr->checkpoint_file);
+	}
+}
+
+// Sets up bound pruning for the solver's targets and numbers.
+static void init_bounds(NumbersCtx *ctx) {
+	ctx->unused_log = 0;
+	for (Index index = 0; index < ctx->count; ++ index) {
+		const LogBound log = value_log(ctx->numbers[index]);
+		ctx->number_logs[index] = log;
+		ctx->unused_log += log;
+	}
+	ctx->prune_log = get_prune_log(ctx->targets);
+}
+
+void solve(ThreadManager *mngr, const TargetSet *targets, const Number numbers[]) {
+	assert(mngr->available_count == mngr->thread_count);
+
+	if (mngr->guided) {
+		// tasks continue in the fixed order
+		assert(mngr->task_count == 0);
+
+		// larger numbers first, equal ones in the order they were given
+		for (Index index = 0; index < mngr->number_count; ++ index) {
+			Index pos = index;
+			for (; pos > 0 && numbers[mngr->guided_order[pos - 1]] < numbers[index]; -- pos) {
+				mngr->guided_order[pos] = mngr->guided_order[pos - 1];
+			}
+			mngr->guided_order[pos] = index;
+		}
+	}
+
+	for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
+		NumbersCtx *solver = &mngr->solvers[thread_index];
+		assert(!solver->active);
+
+		solver->targets        = targets;
+		solver->numbers        = numbers;
+		solver->used_mask      = 0,
+		solver->used_count     = 0,
+		solver->ops_index      = 0;
+		solver->vals_index     = 0;
+		solver->root_ops_index = 0;
+		solver->split_count    = mngr->split_count;
+		solver->task           = NULL;
+		init_bounds(solver);
+	}
+
+	if (mngr->thread_count == 1 && !mngr->checkpoint_file) {
+		solve_inline(mngr);
+		return;
+	}
+
+	thread_manager_start(mngr);
+
+	if (mngr->task_count == 0) {
+		mngr->solvers[0].active = true;
+		mngr->available_count --;
+
+		if (sem_post(&mngr->solvers[0].semaphore) != 0) {
+			panice("posting to semaphore of worker thread 0");
+		}
+	} else {
+		// resuming: hand out the stored tasks, the rest is picked up by
+		// workers as they finish
+		int errnum = pthread_mutex_lock(&mngr->worker_lock);
+		if (errnum != 0) {
+			panicf("locking worker synchronization mutex: %s", strerror(errnum));
+		}
+
+		for (size_t thread_index = 0; thread_index < mngr->thread_count && mngr->task_index < mngr->task_count; ++ thread_index) {
+			NumbersCtx *solver = &mngr->solvers[thread_index];
+			solver->task   = &mngr->tasks[mngr->task_index ++];
+			solver->active = true;
+			mngr->available_count --;
+
+			if (sem_post(&solver->semaphore) != 0) {
+				panice("posting to semaphore of worker thread %zu", thread_index);
+			}
+		}
+
+		errnum = pthread_mutex_unlock(&mngr->worker_lock);
+		if (errnum != 0) {
+			panicf("unlocking worker synchronization mutex: %s", strerror(errnum));
+		}
+	}
+
+	wait_for_workers(mngr);
+}
+
+// Sharding: The search tree is cut at the nodes where depth numbers are used
+// (the same place where work is handed to other threads) and these subtrees
+// are numbered in search order. Shard I of N gets every subtree whose number
+// is I modulo N as a task, the same as tasks of a resumed checkpoint. The
+// nodes above the cut are visited by every shard, but only shard 0 reports
+// their solutions. depth is the smallest one that gives at least
+// SHARD_UNITS_PER_SHARD subtrees per shard, so it only depends on the game
+// and N and all shards agree on it.
+
+#define SHARD_UNITS_PER_SHARD 16
+
+typedef struct ShardS {
+	size_t index;
+	size_t count;
+	Index  depth;
+	bool   collect;
+	size_t unit_count;
+	Task  *tasks;
+	size_t task_count;
+	size_t task_capacity;
+} Shard;
+
+static void shard_node(NumbersCtx *ctx, Shard *shard);
+
+static void shard_add_task(NumbersCtx *ctx, Shard *shard) {
+	if (shard->task_count == shard->task_capacity) {
+		shard->task_capacity = shard->task_capacity == 0 ? 16 : shard->task_capacity * 2;
+		Task *tasks = realloc(shard->tasks, shard->task_capacity * sizeof(Task));
+		if (!tasks) {
+			panice("allocating tasks of size %zu", shard->task_capacity);
+		}
+		shard->tasks = tasks;
+	}
+
+	Element *ops = calloc(ctx->ops_size, sizeof(Element));
+	if (!ops) {
+		panice("allocating operand stack of size %u", ctx->ops_size);
+	}
+	memcpy(ops, ctx->ops, sizeof(Element) * ctx->ops_index);
+
+	shard->tasks[shard->task_count ++] = (Task){
+		.ops            = ops,
+		.root_ops_index = ctx->ops_index,
+		.ops_index      = ctx->ops_index,
+	};
+}
+
+// The value children of the current node, like solve_vals_internal().
+static void shard_vals(NumbersCtx *ctx, Shard *shard) {
+	if (ctx->used_count == ctx->count) {
+		return;
+	}
+
+	if (ctx->used_count == shard->depth) {
+		const size_t unit = shard->unit_count ++;
+		if (shard->collect && unit % shard->count == shard->index) {
+			shard_add_task(ctx, shard);
+		}
+		return;
+	}
+
+	for (Index index = 0; index < ctx->count; ++ index) {
+		const size_t mask = (size_t)1 << index;
+		if (ctx->used_mask & mask) {
+			continue;
+		}
+
+		const Number number = ctx->numbers[index];
+		ctx->used_mask |= mask;
+		++ ctx->used_count;
+		ctx->vals[ctx->vals_index ++] = (ValElement){
+			.value = number,
+			.ops_index = ctx->ops_index,
 		};
+		push_val(ctx, index, number);
+
+		shard_node(ctx, shard);
+
+		pop_op(ctx);
+		-- ctx->vals_index;
+		-- ctx->used_count;
+		ctx->used_mask &= ~mask;
+	}
+}
+
+// Visits a node above the cut like solve_vals_internal() and solve_ops() do:
+// the node itself, its operation children, then its value children.
+static void shard_node(NumbersCtx *ctx, Shard *shard) {
+	if (shard->collect && shard->index == 0) {
+		test_solution(ctx);
+	}
+
+	if (ctx->vals_index > 1) {
+		Number values[OrderEnd] = { 0, 0, 0, 0 };
+		const unsigned int legal = get_legal_ops(ctx, values);
+
+		if (legal != 0) {
+			const ValElement lhs_val = ctx->vals[ctx->vals_index - 2];
+			const ValElement rhs_val = ctx->vals[ctx->vals_index - 1];
+
+			-- ctx->vals_index;
+			for (OpOrder order = OrderAdd; order < OrderEnd; ++ order) {
+				if (legal & (1u << order)) {
+					ctx->vals[ctx->vals_index - 1] = (ValElement){
+						.value = values[order],
+						.ops_index = ctx->ops_index,
+					};
+					push_op(ctx, ORDERED_OPS[order], values[order]);
+					shard_node(ctx, shard);
+					pop_op(ctx);
+				}
+			}
+			++ ctx->vals_index;
+			ctx->vals[ctx->vals_index - 1] = rhs_val;
+			ctx->vals[ctx->vals_index - 2] = lhs_val;
+		}
+	}
+
+	shard_vals(ctx, shard);
+}
+
+// Prints the solutions above the cut (shard 0 only) and queues the subtrees
+// of shard index of count as tasks. solve() has to be called afterwards if
+// there are any tasks.
+void prepare_shard(ThreadManager *mngr, const TargetSet *targets, const Number numbers[], const size_t index, const size_t count) {
+	assert(mngr->task_count == 0);
+	assert(index < count);
+
+	NumbersCtx *ctx = &mngr->solvers[0];
+	ctx->targets    = targets;
+	ctx->numbers    = numbers;
+	ctx->used_mask  = 0;
+	ctx->used_count = 0;
+	ctx->ops_index  = 0;
+	ctx->vals_index = 0;
+
+	Shard shard = {
+		.index         = index,
+		.count         = count,
+		.depth         = 0,
+		.collect       = false,
+		.unit_count    = 0,
+		.tasks         = NULL,
+		.task_count    = 0,
+		.task_capacity = 0,
+	};
+
+	for (; shard.depth + 1 < ctx->count; ++ shard.depth) {
+		shard.unit_count = 0;
+		shard_vals(ctx, &shard);
+		if (shard.unit_count / SHARD_UNITS_PER_SHARD >= count) {
+			break;
+		}
+	}
+
+	shard.collect    = true;
+	shard.unit_count = 0;
+	shard_vals(ctx, &shard);
+
+	// the thread manager takes ownership of the tasks
+	mngr->tasks      = shard.tasks;
+	mngr->task_count = shard.task_count;
+	mngr->task_index = 0;
+}
+
+// Waits for a free worker and marks it as active.
+static NumbersCtx *generate_reserve(ThreadManager *mngr) {
+	for (;;) {
+		for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
+			NumbersCtx *solver = &mngr->solvers[thread_index];
+
+			if (!solver->active) {
+				solver->active = true;
+				return solver;
+			}
+		}
+
+		if (sem_wait(&mngr->semaphore) != 0) {
+			panice("waiting on thread manager semaphore");
+		}
+	}
+}
+
+static void generate_dispatch(NumbersCtx *solver) {
+	if (sem_post(&solver->semaphore) != 0) {
+		panice("posting to semaphore of worker thread %zu", solver->slot);
+	}
+}
+
+// Hands the batch that is being filled to its worker.
+static void generate_flush(ThreadManager *mngr) {
+	NumbersCtx *solver = mngr->filling;
+	if (solver) {
+		mngr->filling = NULL;
+		generate_dispatch(solver);
+	}
+}
+
+void generate(ThreadManager *mngr, const TargetSet *targets, const Number numbers[], void *sink_data) {
+	assert(mngr->available_count == 0);
+
+	thread_manager_start(mngr);
+
+	if (mngr->batch && batch_fits(numbers, mngr->number_count)) {
+		if (mngr->filling && mngr->filling->targets != targets) {
+			generate_flush(mngr);
+		}
+
+		if (!mngr->filling) {
+			NumbersCtx *solver = generate_reserve(mngr);
+			solver->targets = targets;
+			mngr->filling   = solver;
+		}
+
+		Batch *batch = mngr->filling->batch;
+		NumbersCtx *lane = &batch->lanes[batch->lane_count ++];
+		lane->targets   = targets;
+		lane->sink_data = sink_data;
+		lane->prune_log = 0;
+		memcpy((void*) lane->numbers, numbers, mngr->number_count * sizeof(Number));
+
+		if (batch->lane_count == BATCH_LANES) {
+			generate_flush(mngr);
+		}
+		return;
+	}
+
+	NumbersCtx *solver = generate_reserve(mngr);
+	solver->targets    = targets;
+	solver->used_mask  = 0,
+	solver->used_count = 0,
+	solver->ops_index  = 0;
+	solver->vals_index = 0;
+	solver->sink_data  = sink_data;
+
+	memcpy((void*) solver->numbers, numbers, mngr->number_count * sizeof(Number));
+	init_bounds(solver);
+
+	generate_dispatch(solver);
+}
+
+// Waits until all games passed to generate() are solved.
+void generate_wait(ThreadManager *mngr) {
+	generate_flush(mngr);
+
+	for (;;) {
+		size_t thread_index = 0;
+		for (thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
+			NumbersCtx *solver = &mngr->solvers[thread_index];
+
+			if (solver->active) {
+				break;
+			}
+		}
+
+		if (thread_index < mngr->thread_count) {
+			if (sem_wait(&mngr->semaphore) != 0) {
+				panice("waiting on thread manager semaphore");
+			}
+		} else {
+			break;
+		}
+	}
+}
+
+void thread_manager_create(ThreadManager *mngr, const Index count, const size_t threads, const PrintStyle print_style, bool generate) {
+	if (count == 0) {
+		panicf("need at least one number");
+	}
+
+	if (threads == 0) {
+		panicf("need at least one thread");
+	}
+
+	const Index ops_size = count + count - 1;
+	const Index vals_size = count;
+
+	log_table_init();
+
+	NumbersCtx *solvers = cache_aligned_calloc(threads, sizeof(NumbersCtx));
+	if (!solvers) {
+		panice("allocating contexts %zu", threads);
+	}
+
+	*mngr = (ThreadManager) {
+		.number_count    = count,
+		// + 3 proved to be a good balance to reduce thread communication overhead at recursion leafs
+		.split_count     = count > 3 ? count - 3 : 0,
+		.thread_count    = threads,
+		.started         = false,
+		.available_count = generate ? 0 : threads,
+		.solvers         = solvers,
+		.print_style     = print_style,
+		.sink            = print_solution,
+		.game_done       = NULL,
+		.iolock          = PTHREAD_MUTEX_INITIALIZER,
+		.worker_lock     = PTHREAD_MUTEX_INITIALIZER,
+		.generate        = generate,
+		.batch           = false,
+		.guided          = false,
+		.distinct        = false,
+		.slot_count      = generate ? threads * (1 + BATCH_LANES) : threads,
+		.filling         = NULL,
+		.checkpoint_file     = NULL,
+		.checkpoint_interval = 0,
+		.checkpoint_pending  = false,
+		.checkpoint_waiting  = 0,
+		.checkpoint_cond     = PTHREAD_COND_INITIALIZER,
+		.tasks           = NULL,
+		.task_count      = 0,
+		.task_index      = 0,
+	};
+
+	if (sem_init(&mngr->semaphore, 0, 0) != 0) {
+		panice("initializing semaphore of thread manager");
+	}
+
+	if (sem_init(&mngr->checkpoint_semaphore, 0, 0) != 0) {
+		panice("initializing checkpoint semaphore");
+	}
+
+	for (size_t thread_index = 0; thread_index < threads; ++ thread_index) {
+		Element *ops = cache_aligned_calloc(ops_size, sizeof(Element));
+		if (!ops) {
+			panice("allocating operand stack of size %u", ops_size);
+		}
+
+		ValElement *vals = cache_aligned_calloc(vals_size, sizeof(ValElement));
+		if (!vals) {
+			panice("allocating value stack of size %u", vals_size);
+		}
+
+		LogBound *number_logs = cache_aligned_calloc(count, sizeof(LogBound));
+		if (!number_logs) {
+			panice("allocating number bounds of size %u", count);
+		}
+
+		size_t *equal_masks = cache_aligned_calloc(count, sizeof(size_t));
+		if (!equal_masks) {
+			panice("allocating equal number masks of size %u", count);
+		}
+
+		NumbersCtx *solver = &solvers[thread_index];
+
+		*solver = (NumbersCtx){
+			.targets     = NULL,
+			.numbers     = NULL,
+			.count       = count,
+			.used_mask   = 0,
+			.used_count  = 0,
+			.split_count = mngr->split_count,
+			.ops         = ops,
+			.ops_size    = ops_size,
+			.ops_index   = 0,
+			.vals        = vals,
+			.vals_size   = vals_size,
+			.vals_index  = 0,
+			.root_ops_index = 0,
+			.task        = NULL,
+			.number_logs = number_logs,
+			.equal_masks = equal_masks,
+			.unused_log  = 0,
+			.prune_log   = 0,
+			.active      = false,
+			.alive       = true,
+			.interrupt   = false,
+			.paused      = false,
+			.sink_data   = NULL,
+			.slot        = thread_index,
+			.batch       = NULL,
+			.mngr        = mngr,
+		};
+
+		if (generate) {
+			Number *numbers = cache_aligned_calloc(count, sizeof(Number));
+			if (!numbers) {
+				panice("allocating numbers array of size %" PRII, count);
+			}
+			solver->numbers = numbers;
+			solver->batch   = batch_create(mngr, count, threads + thread_index * BATCH_LANES);
+		}
+
+		if (sem_init(&solver->semaphore, 0, 0) != 0) {
+			panice("initializing semaphore of worker thread %zu", thread_index);
+		}
+	}
+}
+
+// Worker threads are only started once they are needed, see solve_inline().
+void thread_manager_start(ThreadManager *mngr) {
+	if (mngr->started) {
+		return;
+	}
+
+	void* (*worker_proc)(void *) = mngr->generate ? &worker_proc_generate : &worker_proc_solve;
+
+	for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
+		NumbersCtx *solver = &mngr->solvers[thread_index];
+
+		int errnum = pthread_create(&solver->thread, NULL, worker_proc, solver);
+		if (errnum != 0) {
+			panicf("starting worker thread %zu: %s", thread_index, strerror(errnum));
+		}
+	}
+
+	mngr->started = true;
+}
+
+void thread_manager_destroy(ThreadManager *mngr) {
+	for (size_t thread_index = 0; thread_index < mngr->thread_count && mngr->started; ++ thread_index) {
+		NumbersCtx *solver = &mngr->solvers[thread_index];
+
+		if (solver->alive) {
+			solver->alive = false;
+
+			if (sem_post(&solver->semaphore) != 0) {
+				panice("posting to semaphore of worker thread %zu", thread_index);
+			}
+		}
+	}
+
+	int errnum = 0;
+	for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
+		NumbersCtx *solver = &mngr->solvers[thread_index];
+
+		if (mngr->started) {
+			errnum = pthread_join(solver->thread, NULL);
+			if (errnum != 0) {
+				fprintf(stderr, "wating for worker thread %zu to end: %s\n", thread_index, strerror(errnum));
+			}
+		}
+
+		if (sem_destroy(&solver->semaphore) != 0) {
+			fprintf(stderr, "freeing semaphore of worker thread %zu: %s\n", thread_index, strerror(errno));
+		}
+
+		free(solver->ops);
+		free(solver->vals);
+		free(solver->number_logs);
+		free(solver->equal_masks);
+
+		if (mngr->generate) {
+			free((void*)solver->numbers);
+			batch_destroy(solver->batch);
+		}
+	}
+
+	free(mngr->solvers);
+
+	for (size_t task_index = 0; task_index < mngr->task_count; ++ task_index) {
+		free(mngr->tasks[task_index].ops);
+	}
+	free(mngr->tasks);
+
+	if (sem_destroy(&mngr->semaphore) != 0) {
+		panice("freeing semaphore of thread manager");
+	}
+
+	if (sem_destroy(&mngr->checkpoint_semaphore) != 0) {
+		panice("freeing checkpoint semaphore");
+	}
+
+	errnum = pthread_cond_destroy(&mngr->checkpoint_cond);
+	if (errnum != 0) {
+		panicf("destroying checkpoint condition: %s", strerror(errnum));
+	}
+
+	errnum = pthread_mutex_destroy(&mngr->worker_lock);
+	if (errnum != 0) {
+		panicf("destroying io mutex: %s", strerror(errnum));
+	}
+
+	errnum = pthread_mutex_destroy(&mngr->iolock);
+	if (errnum != 0) {
+		panicf("destroying io mutex: %s", strerror(errnum));
+	}
+}
+
+// Precomputed answers for the standard game: For every distinct multiset of
+// DEFAULT_NUMBER_COUNT numbers out of NUMBERS[] the set of reachable targets
+// in TABLE_TARGET_START..TABLE_TARGET_END and one canonical solution for each
+// of them. The file is mmap()ed, so looking up a game is just computing its
+// rank among all multisets.
+//
+// A solution is stored as RPN with one nibble per element, the first element
+// in the lowest nibble: 1 to DEFAULT_NUMBER_COUNT is the position of the
+// number in the sorted game plus one, 0xA to 0xD are +, -, * and / and 0 ends
+// the expression. Because the last element is never 0 a shorter expression is
+// always a smaller integer, so the canonical solution is simply the smallest
+// one, which doesn't depend on the search order or the number of threads.
+
+#define TABLE_MAGIC        "NUMTABLE"
+#define TABLE_VERSION      1
+#define TABLE_BYTE_ORDER   0x01020304
+#define TABLE_TARGET_START 100
+#define TABLE_TARGET_END   999
+#define TABLE_TARGET_COUNT (TABLE_TARGET_END - TABLE_TARGET_START + 1)
+#define TABLE_BITMAP_SIZE  ((TABLE_TARGET_COUNT + 63) / 64)
+#define TABLE_OP_CODE      0xA
+#define POOL_SIZE          (sizeof(NUMBERS) / sizeof(Number))
+
+typedef struct TableHeaderS {
+	char     magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t number_count;
+	uint32_t pool_size;
+	uint64_t pool[POOL_SIZE];
+	uint64_t target_start;
+	uint64_t target_end;
+	uint64_t game_count;
+	uint64_t game_size;
+	uint64_t games_offset;
+} TableHeader;
+
+typedef struct TableGameS {
+	uint64_t reachable[TABLE_BITMAP_SIZE];
+	uint64_t solutions[TABLE_TARGET_COUNT];
+} TableGame;
+
+// The distinct values of NUMBERS[] with how often they may be used, and
+// ways[index][count]: the number of multisets of count numbers using only
+// values[index..count).
+typedef struct PoolS {
+	Number values[POOL_SIZE];
+	Index  limits[POOL_SIZE];
+	size_t count;
+	size_t ways[POOL_SIZE + 1][DEFAULT_NUMBER_COUNT + 1];
+} Pool;
+
+typedef struct TableS {
+	Pool               pool;
+	const TableHeader *header;
+	const TableGame   *games;
+	size_t             size;
+} Table;
+
+static int compare_numbers(const void *lhs, const void *rhs) {
+	const Number lhs_value = *(const Number*)lhs;
+	const Number rhs_value = *(const Number*)rhs;
+	return lhs_value < rhs_value ? -1 : lhs_value > rhs_value ? 1 : 0;
+}
+
+static void pool_init(Pool *pool) {
+	Number sorted[POOL_SIZE];
+	memcpy(sorted, NUMBERS, sizeof(NUMBERS));
+	qsort(sorted, POOL_SIZE, sizeof(Number), compare_numbers);
+
+	pool->count = 0;
+	for (size_t index = 0; index < POOL_SIZE; ++ index) {
+		if (pool->count > 0 && pool->values[pool->count - 1] == sorted[index]) {
+			++ pool->limits[pool->count - 1];
+		} else {
+			pool->values[pool->count] = sorted[index];
+			pool->limits[pool->count] = 1;
+			++ pool->count;
+		}
+	}
+
+	for (size_t count = 0; count <= DEFAULT_NUMBER_COUNT; ++ count) {
+		pool->ways[pool->count][count] = count == 0;
+	}
+
+	for (size_t index = pool->count; index > 0; -- index) {
+		for (size_t count = 0; count <= DEFAULT_NUMBER_COUNT; ++ count) {
+			size_t ways = 0;
+			for (size_t used = 0; used <= pool->limits[index - 1] && used <= count; ++ used) {
+				ways += pool->ways[index][count - used];
+			}
+			pool->ways[index - 1][count] = ways;
+		}
+	}
+}
+
+static inline size_t pool_game_count(const Pool *pool) {
+	return pool->ways[0][DEFAULT_NUMBER_COUNT];
+}
+
+// Index of the sorted game among all multisets in the order in which
+// table_build_games() enumerates them, or SIZE_MAX if it isn't a standard game.
+static size_t pool_rank(const Pool *pool, const Number sorted[DEFAULT_NUMBER_COUNT]) {
+	size_t rank = 0;
+	size_t left = DEFAULT_NUMBER_COUNT;
+	size_t number_index = 0;
+
+	for (size_t index = 0; index < pool->count; ++ index) {
+		size_t used = 0;
+		while (number_index < DEFAULT_NUMBER_COUNT && sorted[number_index] == pool->values[index]) {
+			++ used;
+			++ number_index;
+		}
+
+		if (used > pool->limits[index]) {
+			return SIZE_MAX;
+		}
+
+		for (size_t less = 0; less < used; ++ less) {
+			rank += pool->ways[index + 1][left - less];
+		}
+		left -= used;
+	}
+
+	return number_index == DEFAULT_NUMBER_COUNT ? rank : SIZE_MAX;
+}
+
+static void table_record_solution(NumbersCtx *ctx, const Number result) {
+	TableGame *game = ctx->sink_data;
+	const size_t target_index = result - TABLE_TARGET_START;
+
+	uint64_t code = 0;
+	for (Index index = ctx->ops_index; index > 0; -- index) {
+		const Element *elem = &ctx->ops[index - 1];
+		code <<= 4;
+		code |= elem->op == OpVal ? elem->index + 1u : TABLE_OP_CODE + get_op_order(elem->op);
+	}
+
+	const uint64_t bit = UINT64_C(1) << (target_index % 64);
+	uint64_t *reachable = &game->reachable[target_index / 64];
+	if (!(*reachable & bit) || code < game->solutions[target_index]) {
+		*reachable |= bit;
+		game->solutions[target_index] = code;
+	}
+}
+
+static size_t table_build_games(ThreadManager *mngr, const Pool *pool, const TargetSet *targets, TableGame *games,
+                                Number numbers[], size_t pool_index, size_t number_index, size_t game_index) {
+	if (number_index == DEFAULT_NUMBER_COUNT) {
+		generate(mngr, targets, numbers, &games[game_index]);
+		return game_index + 1;
+	}
+
+	if (pool_index == pool->count) {
+		return game_index;
+	}
+
+	const size_t left = DEFAULT_NUMBER_COUNT - number_index;
+	for (size_t used = 0; used <= pool->limits[pool_index] && used <= left; ++ used) {
+		for (size_t index = 0; index < used; ++ index) {
+			numbers[number_index + index] = pool->values[pool_index];
+		}
+		assert(used < left || pool_rank(pool, numbers) == game_index);
+		game_index = table_build_games(mngr, pool, targets, games, numbers, pool_index + 1, number_index + used, game_index);
+	}
+
+	return game_index;
+}
+
+void build_table(const char *filename, const size_t threads) {
+	Pool pool;
+	pool_init(&pool);
+
+	const size_t game_count = pool_game_count(&pool);
+	const size_t size = sizeof(TableHeader) + game_count * sizeof(TableGame);
+
+	const size_t filename_len = strlen(filename);
+	char *tmp_filename = malloc(filename_len + 5);
+	if (!tmp_filename) {
+		panice("allocating file name");
+	}
+	memcpy(tmp_filename, filename, filename_len);
+	memcpy(tmp_filename + filename_len, ".tmp", 5);
+
+	const int fd = open(tmp_filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		panice("opening table file: %s", tmp_filename);
+	}
+
+	if (ftruncate(fd, size) != 0) {
+		panice("resizing table file to %zu bytes: %s", size, tmp_filename);
+	}
+
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		panice("mapping table file: %s", tmp_filename);
+	}
+
+	TableHeader *header = data;
+	TableGame *games = (TableGame*)((char*)data + sizeof(TableHeader));
+
+	*header = (TableHeader){
+		.version      = TABLE_VERSION,
+		.byte_order   = TABLE_BYTE_ORDER,
+		.number_count = DEFAULT_NUMBER_COUNT,
+		.pool_size    = POOL_SIZE,
+		.target_start = TABLE_TARGET_START,
+		.target_end   = TABLE_TARGET_END,
+		.game_count   = game_count,
+		.game_size    = sizeof(TableGame),
+		.games_offset = sizeof(TableHeader),
+	};
+	for (size_t index = 0; index < POOL_SIZE; ++ index) {
+		header->pool[index] = NUMBERS[index];
+	}
+
+	TargetSet targets;
+	target_set_create(&targets);
+	target_set_add(&targets, (TargetRange){ .start = TABLE_TARGET_START, .end = TABLE_TARGET_END });
+	target_set_normalize(&targets);
+
+	ThreadManager mngr;
+	thread_manager_create(&mngr, DEFAULT_NUMBER_COUNT, threads, PrintRpn, true);
+	mngr.sink  = table_record_solution;
+	mngr.batch = true;
+
+	Number numbers[DEFAULT_NUMBER_COUNT];
+	const size_t built_count = table_build_games(&mngr, &pool, &targets, games, numbers, 0, 0, 0);
+	assert(built_count == game_count);
+	(void)built_count;
+	generate_wait(&mngr);
+
+	thread_manager_destroy(&mngr);
+	target_set_destroy(&targets);
+
+	// the magic is written last, so an interrupted build is never a valid table
+	memcpy(header->magic, TABLE_MAGIC, sizeof(header->magic));
+
+	if (msync(data, size, MS_SYNC) != 0) {
+		panice("writing table file: %s", tmp_filename);
+	}
+
+	if (munmap(data, size) != 0) {
+		panice("unmapping table file: %s", tmp_filename);
+	}
+
+	if (fsync(fd) != 0) {
+		panice("writing table file: %s", tmp_filename);
+	}
+
+	if (close(fd) != 0) {
+		panice("closing table file: %s", tmp_filename);
+	}
+
+	if (rename(tmp_filename, filename) != 0) {
+		panice("renaming %s to %s", tmp_filename, filename);
+	}
+
+	free(tmp_filename);
+}
+
+void table_open(Table *table, const char *filename) {
+	pool_init(&table->pool);
+
+	const int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		panice("opening table file: %s", filename);
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		panice("reading table file: %s", filename);
+	}
+
+	if ((size_t)info.st_size < sizeof(TableHeader)) {
+		panicf("not a numbers table file: %s", filename);
+	}
+
+	table->size = info.st_size;
+	void *data = mmap(NULL, table->size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		panice("mapping table file: %s", filename);
+	}
+
+	if (close(fd) != 0) {
+		panice("closing table file: %s", filename);
+	}
+
+	const TableHeader *header = data;
+	if (memcmp(header->magic, TABLE_MAGIC, sizeof(header->magic)) != 0) {
+		panicf("not a numbers table file: %s", filename);
+	}
+
+	if (header->version != TABLE_VERSION) {
+		panicf("unsupported table version %" PRIu32 ": %s", header->version, filename);
+	}
+
+	if (header->byte_order != TABLE_BYTE_ORDER) {
+		panicf("table file was built on a machine with a different byte order: %s", filename);
+	}
+
+	if (header->number_count != DEFAULT_NUMBER_COUNT ||
+	    header->pool_size    != POOL_SIZE ||
+	    header->target_start != TABLE_TARGET_START ||
+	    header->target_end   != TABLE_TARGET_END ||
+	    header->game_count   != pool_game_count(&table->pool) ||
+	    header->game_size    != sizeof(TableGame) ||
+	    header->games_offset != sizeof(TableHeader) ||
+	    header->games_offset + header->game_count * header->game_size > table->size) {
+		panicf("table file doesn't match this build: %s", filename);
+	}
+
+	for (size_t index = 0; index < POOL_SIZE; ++ index) {
+		if (header->pool[index] != NUMBERS[index]) {
+			panicf("table file was built for different numbers: %s", filename);
+		}
+	}
+
+	table->header = header;
+	table->games  = (const TableGame*)((const char*)data + header->games_offset);
+}
+
+void table_close(Table *table) {
+	if (munmap((void*)table->header, table->size) != 0) {
+		panice("unmapping table file");
+	}
+	table->header = NULL;
+	table->games  = NULL;
+	table->size   = 0;
+}
+
+// Prints the canonical solution of every reachable target. Returns false if
+// the game or the targets aren't covered by the table, so it has to be solved
+// the normal way.
+bool table_solve(const Table *table, const PrintStyle print_style, const TargetSet *targets, const Number numbers[], const Index count) {
+	if (count != DEFAULT_NUMBER_COUNT || targets->count == 0 ||
+	    targets->min < TABLE_TARGET_START || targets->max > TABLE_TARGET_END) {
+		return false;
+	}
+
+	Number sorted[DEFAULT_NUMBER_COUNT];
+	memcpy(sorted, numbers, sizeof(sorted));
+	qsort(sorted, DEFAULT_NUMBER_COUNT, sizeof(Number), compare_numbers);
+
+	const size_t rank = pool_rank(&table->pool, sorted);
+	if (rank == SIZE_MAX) {
+		return false;
+	}
+
+	const TableGame *game = &table->games[rank];
+
+	// just enough of a solver to print solutions
+	ThreadManager mngr = {
+		.print_style = print_style,
+		.iolock      = PTHREAD_MUTEX_INITIALIZER,
+	};
+	Element ops[DEFAULT_NUMBER_COUNT + DEFAULT_NUMBER_COUNT - 1];
+	NumbersCtx ctx = {
+		.targets  = targets,
+		.numbers  = sorted,
+		.count    = DEFAULT_NUMBER_COUNT,
+		.ops      = ops,
+		.ops_size = DEFAULT_NUMBER_COUNT + DEFAULT_NUMBER_COUNT - 1,
+		.mngr     = &mngr,
+	};
+
+	for (size_t range_index = 0; range_index < targets->count; ++ range_index) {
+		const TargetRange range = targets->ranges[range_index];
+		for (Number target = range.start; target <= range.end; ++ target) {
+			const size_t target_index = target - TABLE_TARGET_START;
+			if (!(game->reachable[target_index / 64] & (UINT64_C(1) << (target_index % 64)))) {
+				continue;
+			}
+
+			ctx.ops_index = 0;
+			for (uint64_t code = game->solutions[target_index]; code; code >>= 4) {
+				const unsigned int elem = code & 0xF;
+				if (elem >= TABLE_OP_CODE) {
+					push_op(&ctx, ORDERED_OPS[elem - TABLE_OP_CODE], 0);
+				} else {
+					assert(elem >= 1 && elem <= DEFAULT_NUMBER_COUNT);
+					push_val(&ctx, elem - 1, sorted[elem - 1]);
+				}
+			}
+
+			print_solution(&ctx, target);
+		}
+	}
+
+	return true;
+}
+
+// Anytime search for games that are too big to be searched exhaustively:
+// Random rollouts build an expression one step at a time using the same
+// legality rules as solve_ops(). In every other step the step is greedy:
+// If there is a single running value it is combined with whichever unused
+// number and operation gets it closest to a target, otherwise the closest
+// operation is applied. Every other rollout starts from a random prefix of
+// the best expression found so far, which makes it a local search around it.
+// Each expression that is closer to a target than the best one so far, or as
+// close and shorter, is printed right away.
+
+#define ANYTIME_SEED        UINT64_C(0x9E3779B97F4A7C15)
+#define ANYTIME_CLOCK_NODES 4096
+
+// xorshift64*
+static inline uint64_t random_next(uint64_t *state) {
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * UINT64_C(0x2545F4914F6CDD1D);
+}
+
+static double get_monotonic_time() {
+	struct timespec now;
+	if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+		panice("getting monotonic time");
+	}
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void anytime_push_val(NumbersCtx *ctx, const Index index) {
+	const Number number = ctx->numbers[index];
+	ctx->used_mask |= (size_t)1 << index;
+	++ ctx->used_count;
+	ctx->vals[ctx->vals_index ++] = (ValElement){
+		.value = number,
+		.ops_index = ctx->ops_index,
+	};
+	push_val(ctx, index, number);
+}
+
+static void anytime_push_op(NumbersCtx *ctx, const Op op, const Number value) {
+	-- ctx->vals_index;
+	ctx->vals[ctx->vals_index - 1] = (ValElement){
+		.value = value,
+		.ops_index = ctx->ops_index,
+	};
+	push_op(ctx, op, value);
+}
+
+static void anytime_pop_val(NumbersCtx *ctx, const Index index) {
+	pop_op(ctx);
+	-- ctx->vals_index;
+	-- ctx->used_count;
+	ctx->used_mask &= ~((size_t)1 << index);
+}
+
+static unsigned int anytime_legal_ops(const NumbersCtx *ctx, Number values[OrderEnd]) {
+	if (ctx->vals_index < 2) {
+		return 0;
+	}
+
+	return get_legal_ops(ctx, values);
+}
+
+void anytime_search(const TargetSet *targets, const Number numbers[], const Index count, const PrintStyle print_style,
+                    const unsigned long time_limit, const unsigned long node_limit) {
+	const Index ops_size = count + count - 1;
+
+	Element *ops = calloc(ops_size, sizeof(Element));
+	if (!ops) {
+		panice("allocating operand stack of size %u", ops_size);
+	}
+
+	Element *best_ops = calloc(ops_size, sizeof(Element));
+	if (!best_ops) {
+		panice("allocating operand stack of size %u", ops_size);
+	}
+
+	ValElement *vals = calloc(count, sizeof(ValElement));
+	if (!vals) {
+		panice("allocating value stack of size %u", count);
+	}
+
+	// just enough of a solver to check operations and print solutions
+	ThreadManager mngr = {
+		.print_style = print_style,
+		.iolock      = PTHREAD_MUTEX_INITIALIZER,
+	};
+	NumbersCtx ctx = {
+		.targets   = targets,
+		.numbers   = numbers,
+		.count     = count,
+		.ops       = ops,
+		.ops_size  = ops_size,
+		.vals      = vals,
+		.vals_size = count,
+		.mngr      = &mngr,
+	};
+
+	uint64_t random_state = ANYTIME_SEED;
+	Index best_ops_index = 0;
+	Number best_distance = 0;
+	unsigned long nodes = 0;
+	unsigned long next_clock_nodes = ANYTIME_CLOCK_NODES;
+	const double deadline = get_monotonic_time() + (double)time_limit;
+
+	for (;;) {
+		ctx.used_mask  = 0;
+		ctx.used_count = 0;
+		ctx.ops_index  = 0;
+		ctx.vals_index = 0;
+
+		if (best_ops_index > 0 && (random_next(&random_state) & 1)) {
+			const Index prefix = random_next(&random_state) % best_ops_index;
+			for (Index index = 0; index < prefix; ++ index) {
+				const Element *elem = &best_ops[index];
+				if (elem->op == OpVal) {
+					anytime_push_val(&ctx, elem->index);
+				} else {
+					anytime_push_op(&ctx, elem->op, elem->value);
+				}
+			}
+		}
+
+		for (;;) {
+			Number values[OrderEnd] = { 0, 0, 0, 0 };
+			unsigned int legal = anytime_legal_ops(&ctx, values);
+			const uint64_t random = random_next(&random_state);
+			Index push_index = count;
+			OpOrder op_order = OrderEnd;
+			Number op_value = 0;
+
+			if (random & 1) {
+				// greedy: get as close to a target as possible
+				Number op_distance = 0;
+				size_t ties = 0;
+				if (ctx.vals_index == 1) {
+					// combine the running value with any unused number
+					for (Index index = 0; index < count; ++ index) {
+						if (ctx.used_mask & ((size_t)1 << index)) {
+							continue;
+						}
+
+						anytime_push_val(&ctx, index);
+						++ nodes;
+						Number push_values[OrderEnd] = { 0, 0, 0, 0 };
+						const unsigned int push_legal = anytime_legal_ops(&ctx, push_values);
+						for (OpOrder order = OrderAdd; order < OrderEnd; ++ order) {
+							if (push_legal & (1u << order)) {
+								const Number distance = target_set_distance(targets, push_values[order]);
+								if (op_order == OrderEnd || distance < op_distance) {
+									ties = 1;
+								} else if (distance > op_distance || random_next(&random_state) % ++ ties != 0) {
+									continue;
+								}
+								push_index  = index;
+								op_order    = order;
+								op_value    = push_values[order];
+								op_distance = distance;
+							}
+						}
+						anytime_pop_val(&ctx, index);
+					}
+				} else {
+					for (OpOrder order = OrderAdd; order < OrderEnd; ++ order) {
+						if (legal & (1u << order)) {
+							const Number distance = target_set_distance(targets, values[order]);
+							if (op_order == OrderEnd || distance < op_distance) {
+								op_order    = order;
+								op_value    = values[order];
+								op_distance = distance;
+							}
+						}
+					}
+				}
+			}
+
+			if (op_order == OrderEnd) {
+				// random move
+				const size_t legal_count = __builtin_popcount(legal);
+				const size_t move_count = legal_count + (count - ctx.used_count);
+				if (move_count == 0) {
+					break;
+				}
+
+				size_t move = (random >> 1) % move_count;
+				if (move < legal_count) {
+					for (op_order = OrderAdd; !(legal & (1u << op_order)) || move-- > 0; ++ op_order);
+					op_value = values[op_order];
+				} else {
+					move -= legal_count;
+					for (push_index = 0; (ctx.used_mask & ((size_t)1 << push_index)) || move-- > 0; ++ push_index);
+				}
+			}
+
+			if (push_index < count) {
+				anytime_push_val(&ctx, push_index);
+				++ nodes;
+			}
+
+			if (op_order != OrderEnd) {
+				anytime_push_op(&ctx, ORDERED_OPS[op_order], op_value);
+				++ nodes;
+			}
+
+			if (ctx.vals_index == 1) {
+				const Number result = ctx.vals[0].value;
+				const Number distance = target_set_distance(targets, result);
+				if (best_ops_index == 0 || distance < best_distance ||
+				    (distance == best_distance && ctx.ops_index < best_ops_index)) {
+					best_distance  = distance;
+					best_ops_index = ctx.ops_index;
+					memcpy(best_ops, ctx.ops, sizeof(Element) * ctx.ops_index);
+
+					print_solution_with_result(&ctx, result, true);
+					fflush(stdout);
+
+					if (distance == 0 && best_ops_index == 1) {
+						// can't get any better
+						goto done;
+					}
+				}
+			}
+
+			if (node_limit > 0 && nodes >= node_limit) {
+				goto done;
+			}
+
+			if (time_limit > 0 && nodes >= next_clock_nodes) {
+				if (get_monotonic_time() >= deadline) {
+					goto done;
+				}
+				next_clock_nodes = nodes + ANYTIME_CLOCK_NODES;
+			}
+		}
+	}
+
+done:
+	free(ops);
+	free(best_ops);
+	free(vals);
+}
+
+// Scheduling: The size of the search tree is estimated with random dives
+// from the root (Knuth's estimator: the product of the numbers of children
+// along a random path estimates the number of nodes at that depth). From the
+// estimated number of nodes per count of used numbers it is decided how many
+// threads are worth starting and down to which depth work is handed to other
+// threads. The dives use a fixed seed, so the plan is always the same for the
+// same game.
+
+#define PLAN_DIVES              256
+#define PLAN_NODES_PER_THREAD   1000000.0
+#define PLAN_MIN_SPLIT_NODES    4000.0
+
+typedef struct PlanS {
+	size_t threads;
+	Index  split_count;
+	double nodes;
+} Plan;
+
+// Adds one random dive to the estimated node counts per used numbers.
+static void plan_dive(NumbersCtx *ctx, uint64_t *random_state, double level_nodes[]) {
+	ctx->used_mask  = 0;
+	ctx->used_count = 0;
+	ctx->ops_index  = 0;
+	ctx->vals_index = 0;
+
+	double weight = 1;
+	for (;;) {
+		Number values[OrderEnd] = { 0, 0, 0, 0 };
+		const unsigned int legal = ctx->vals_index > 1 ? get_legal_ops(ctx, values) : 0;
+		const size_t legal_count = __builtin_popcount(legal);
+		const size_t child_count = legal_count + (ctx->count - ctx->used_count);
+
+		if (child_count == 0) {
+			break;
+		}
+
+		weight *= child_count;
+		size_t child = random_next(random_state) % child_count;
+		if (child < legal_count) {
+			OpOrder order = OrderAdd;
+			for (; !(legal & (1u << order)) || child-- > 0; ++ order);
+			anytime_push_op(ctx, ORDERED_OPS[order], values[order]);
+		} else {
+			child -= legal_count;
+			Index index = 0;
+			for (; (ctx->used_mask & ((size_t)1 << index)) || child-- > 0; ++ index);
+			anytime_push_val(ctx, index);
+		}
+
+		level_nodes[ctx->used_count] += weight;
+	}
+}
+
+// With N shards every process only searches about an N-th of the nodes.
+void plan_search(Plan *plan, const TargetSet *targets, const Number numbers[], const Index count, const size_t max_threads, const size_t shard_count) {
+	const Index ops_size = count + count - 1;
+	Element *ops = calloc(ops_size, sizeof(Element));
+	if (!ops) {
+		panice("allocating operand stack of size %u", ops_size);
+	}
+
+	ValElement *vals = calloc(count, sizeof(ValElement));
+	if (!vals) {
+		panice("allocating value stack of size %u", count);
+	}
+
+	double *level_nodes = calloc(count + 1, sizeof(double));
+	if (!level_nodes) {
+		panice("allocating node estimates of size %u", count + 1);
+	}
+
+	NumbersCtx ctx = {
+		.targets   = targets,
+		.numbers   = numbers,
+		.count     = count,
+		.ops       = ops,
+		.ops_size  = ops_size,
+		.vals      = vals,
+		.vals_size = count,
+	};
+
+	uint64_t random_state = ANYTIME_SEED;
+	for (size_t dive = 0; dive < PLAN_DIVES; ++ dive) {
+		plan_dive(&ctx, &random_state, level_nodes);
+	}
+
+	double nodes = 0;
+	for (Index used = 0; used <= count; ++ used) {
+		level_nodes[used] /= PLAN_DIVES;
+		nodes += level_nodes[used];
+	}
+
+	// Work is handed off right after a number is used, so a split below
+	// used numbers moves on average all nodes with more used numbers divided
+	// by the nodes with used numbers. Split as deep as that still pays off.
+	Index split_count = 0;
+	double below = nodes - level_nodes[0];
+	for (Index used = 1; used < count; ++ used) {
+		below -= level_nodes[used];
+		if (below / level_nodes[used] >= PLAN_MIN_SPLIT_NODES) {
+			split_count = used + 1;
+		}
+	}
+
+	double threads = nodes / shard_count / PLAN_NODES_PER_THREAD;
+	plan->threads = threads < 1 ? 1 : threads >= max_threads ? max_threads : (size_t)threads;
+	plan->split_count = split_count;
+	plan->nodes = nodes;
+
+	free(level_nodes);
+	free(vals);
+	free(ops);
+}
+
+// Estimation: Like the dives of the scheduling, but they follow the search
+// exactly, including bound pruning: Pruned operations are no children and a
+// pruned number is a leaf. Every probe adds the product of the numbers of
+// children along its path for every node it visits, the average over all
+// probes estimates the number of nodes of the search. Wherever a probe gets
+// to ESTIMATE_EXACT_UNUSED unused numbers the subtree below is also searched
+// for real, which gives its solutions, their output size, and how long it
+// took. Multiplied with the same product they estimate the whole search.
+// Because most of the work is done in these small subtrees, the spread of
+// the results stays small. The intervals are the usual normal approximation
+// for 95%, which is too optimistic for games with very uneven subtrees.
+
+#define ESTIMATE_SECONDS        0.2
+#define ESTIMATE_MAX_PROBES     1000000
+#define ESTIMATE_EXACT_UNUSED   3
+#define ESTIMATE_Z              1.96
+
+typedef struct EstimateSumS {
+	double sum;
+	double sum_sq;
+} EstimateSum;
+
+typedef struct EstimateS {
+	size_t      probes;
+	double      seconds;
+	EstimateSum nodes;
+	EstimateSum solutions;
+	EstimateSum bytes;
+	EstimateSum runtime;
+} Estimate;
+
+// Solutions and output size of the current exact subtree of a probe.
+typedef struct EstimateCountS {
+	double solutions;
+	double bytes;
+} EstimateCount;
+
+static void estimate_record_solution(NumbersCtx *ctx, const Number result) {
+	EstimateCount *count = ctx->sink_data;
+	char buf[SOLUTION_BUFFER_SIZE(ctx->ops_index)];
+	const char *end = format_solution_line(ctx, result, !target_set_is_single(ctx->targets), buf);
+
+	count->solutions += 1;
+	count->bytes     += end - buf;
+}
+
+static inline void estimate_sum_add(EstimateSum *sum, const double value) {
+	sum->sum    += value;
+	sum->sum_sq += value * value;
+}
+
+// Same as solve_vals_from() does, returns false if the number is pruned.
+static bool estimate_push_val(NumbersCtx *ctx, const Index index) {
+	const Number number = ctx->numbers[index];
+	const LogBound number_log = ctx->number_logs[index];
+	const LogBound log = (ctx->vals_index > 0 ? ctx->vals[ctx->vals_index - 1].log : 0) + number_log;
+	ctx->used_mask |= (size_t)1 << index;
+	++ ctx->used_count;
+	ctx->vals[ctx->vals_index ++] = (ValElement){
+		.value = number,
+		.ops_index = ctx->ops_index,
+		.log = log,
+	};
+	push_val(ctx, index, number);
+	ctx->unused_log -= number_log;
+
+	return log + ctx->unused_log > ctx->prune_log;
+}
+
+// Same as solve_op() does, only called for operations that aren't pruned.
+static void estimate_push_op(NumbersCtx *ctx, const Op op, const Number value) {
+	-- ctx->vals_index;
+	ctx->vals[ctx->vals_index - 1] = (ValElement){
+		.value = value,
+		.ops_index = ctx->ops_index,
+		.log = (ctx->vals_index > 1 ? ctx->vals[ctx->vals_index - 2].log : 0) + value_log(value),
+	};
+	push_op(ctx, op, value);
+}
+
+// Runs one probe from the root and adds what it found to estimate.
+static void estimate_probe(NumbersCtx *ctx, uint64_t *random_state, Estimate *estimate) {
+	EstimateCount *count = ctx->sink_data;
+
+	ctx->used_mask  = 0;
+	ctx->used_count = 0;
+	ctx->ops_index  = 0;
+	ctx->vals_index = 0;
+	init_bounds(ctx);
+
+	double weight    = 1;
+	double nodes     = 0;
+	double solutions = 0;
+	double bytes     = 0;
+	double runtime   = 0;
+	bool   searched  = false;
+
+	for (;;) {
+		if (!searched && ctx->count - ctx->used_count <= ESTIMATE_EXACT_UNUSED) {
+			*count = (EstimateCount){ .solutions = 0, .bytes = 0 };
+
+			const double start = get_monotonic_time();
+			test_solution(ctx);
+			solve_ops(ctx);
+			solve_vals(ctx);
+			runtime = weight * (get_monotonic_time() - start);
+
+			solutions += weight * count->solutions;
+			bytes     += weight * count->bytes;
+			searched = true;
+		}
+
+		Number values[OrderEnd] = { 0, 0, 0, 0 };
+		unsigned int legal = ctx->vals_index > 1 ? get_legal_ops(ctx, values) : 0;
+		for (OpOrder order = OrderAdd; order < OrderEnd; ++ order) {
+			if (legal & (1u << order)) {
+				const LogBound log = (ctx->vals_index > 2 ? ctx->vals[ctx->vals_index - 3].log : 0) + value_log(values[order]);
+				if (log + ctx->unused_log <= ctx->prune_log) {
+					legal &= ~(1u << order);
+				}
+			}
+		}
+
+		const size_t legal_count = __builtin_popcount(legal);
+		const size_t child_count = legal_count + (ctx->count - ctx->used_count);
+
+		if (child_count == 0) {
+			break;
+		}
+
+		weight *= child_count;
+		nodes  += weight;
+
+		size_t child = random_next(random_state) % child_count;
+		if (child < legal_count) {
+			OpOrder order = OrderAdd;
+			for (; !(legal & (1u << order)) || child-- > 0; ++ order);
+			estimate_push_op(ctx, ORDERED_OPS[order], values[order]);
+		} else {
+			child -= legal_count;
+			Index index = 0;
+			for (; (ctx->used_mask & ((size_t)1 << index)) || child-- > 0; ++ index);
+			if (!estimate_push_val(ctx, index)) {
+				break;
+			}
+		}
+
+		// a node that starts the exact subtree is tested there
+		if (ctx->count - ctx->used_count > ESTIMATE_EXACT_UNUSED &&
+		    ctx->vals_index == 1 && target_set_contains(ctx->targets, ctx->vals[0].value)) {
+			*count = (EstimateCount){ .solutions = 0, .bytes = 0 };
+			estimate_record_solution(ctx, ctx->vals[0].value);
+			solutions += weight;
+			bytes     += weight * count->bytes;
+		}
+	}
+
+	estimate_sum_add(&estimate->nodes,     nodes);
+	estimate_sum_add(&estimate->solutions, solutions);
+	estimate_sum_add(&estimate->bytes,     bytes);
+	estimate_sum_add(&estimate->runtime,   runtime);
+	++ estimate->probes;
+}
+
+// Estimates the size of the single threaded search of the game with random
+// probes for about ESTIMATE_SECONDS. The probes use a fixed seed, but how
+// many there are depends on the speed of the machine.
+void estimate_search(Estimate *estimate, const TargetSet *targets, const Number numbers[], const Index count, const PrintStyle print_style) {
+	ThreadManager mngr;
+	thread_manager_create(&mngr, count, 1, print_style, false);
+
+	// never hand off work, there are no other threads
+	mngr.available_count = 0;
+	mngr.sink = estimate_record_solution;
+
+	EstimateCount probe_count;
+	NumbersCtx *ctx = &mngr.solvers[0];
+	ctx->targets     = targets;
+	ctx->numbers     = numbers;
+	ctx->split_count = 0;
+	ctx->sink_data   = &probe_count;
+
+	*estimate = (Estimate){ .probes = 0 };
+
+	uint64_t random_state = ANYTIME_SEED;
+	const double start = get_monotonic_time();
+	const double deadline = start + ESTIMATE_SECONDS;
+	do {
+		estimate_probe(ctx, &random_state, estimate);
+	} while (estimate->probes < ESTIMATE_MAX_PROBES && get_monotonic_time() < deadline);
+	estimate->seconds = get_monotonic_time() - start;
+
+	thread_manager_destroy(&mngr);
+}
+
+#ifndef NUMBERS_NO_MAIN
+static double estimate_mean(const EstimateSum *sum, const size_t probes) {
+	return sum->sum / probes;
+}
+
+// Half the width of the confidence interval of the mean.
+static double estimate_error(const EstimateSum *sum, const size_t probes) {
+	if (probes < 2) {
+		return 0;
+	}
+	const double mean = sum->sum / probes;
+	const double variance = (sum->sum_sq - mean * sum->sum) / (probes - 1);
+	return variance > 0 ? ESTIMATE_Z * sqrt(variance / probes) : 0;
+}
+
+static void print_estimate_line(const char *label, const EstimateSum *sum, const Estimate *estimate, const char *unit) {
+	if (sum->sum == 0) {
+		// rare solutions can be missed by all probes, so this is no proof
+		printf("%-11s0%s (none found by the probes)\n", label, unit);
+		return;
+	}
+
+	const double mean  = estimate_mean(sum, estimate->probes);
+	const double error = estimate_error(sum, estimate->probes);
+	printf("%-11s%.3g%s (95%%: %.3g .. %.3g)\n", label, mean, unit, mean > error ? mean - error : 0, mean + error);
+}
+
+static void print_estimate(const Estimate *estimate) {
+	printf("probes:    %zu in %.3g seconds\n", estimate->probes, estimate->seconds);
+	print_estimate_line("nodes:",     &estimate->nodes,     estimate, "");
+	print_estimate_line("solutions:", &estimate->solutions, estimate, "");
+	print_estimate_line("output:",    &estimate->bytes,     estimate, " bytes");
+	print_estimate_line("runtime:",   &estimate->runtime,   estimate, " seconds");
+}
+#endif
+
+#ifndef NUMBERS_NO_MAIN
+static void usage(int argc, char *const argv[]) {
+	const char *bin = argc > 0 ? argv[0] : "numbers";
+	printf("Usage: %s [OPTIONS] TARGET NUMBER...\n", bin);
+	printf("       %s --generate [--max-solutions=K] [TARGET]\n", bin);
+	printf("       %s --resume=FILE [OPTIONS]\n", bin);
+	printf("       %s --build-table=FILE [--threads=COUNT]\n", bin);
+	printf(
+		"\n"
+		"TARGET may be a single number, an inclusive range in the form START..END, or\n"
+		"a comma separated list of those. All targets are searched at once.\n"
+		"\n"
+		"EXAMPLE:\n"
+		"\n"
+		"\t%s 100..200 1 2 3 25 50 75\n"
+		"\t%s 137,412,865 1 2 3 25 50 75\n"
+		"\n"
+		"OPTIONS:\n"
+		"\n"
+		"\t-h, --help             Print this help message.\n"
+		"\t-t, --threads=COUNT    Spawn COUNT threads. (default: auto)\n"
+		"\n"
+		"\t                       Special COUNT values:\n"
+#ifdef HAS_GET_CPU_COUNT
+		"\t                          auto ...... estimate the size of the game and use\n"
+		"\t                                      up to the number of CPUs\n"
+		"\t                          cpus ...... use number of CPUs (CPU cores)\n"
+#else
+		"\t                          auto ...... estimate the size of the game and use\n"
+		"\t                                      up to the number count\n"
+#endif
+		"\t                          numbers ... use number count\n"
+		"\n"
+		"\t                       auto uses cpus (numbers) with --generate, --resume\n"
+		"\t                       and --build-table.\n"
+		"\n"
+		"\t                       Note: If more than 1 thread is used the order of the\n"
+		"\t                       results is random.\n"
+		"\n"
+		"\t-r, --rpn              Print solutions in reverse Polish notation.\n"
+		"\t-e, --expr             Print solutions in usual notation (default).\n"
+		"\t-p, --paren            Like --expr but never skip parenthesis.\n"
+		"\t-g, --generate         Generate standard numbers games with %u numbers and\n"
+		"\t                       their solutions. If no target is given all targets\n"
+		"\t                       from 100 to 999 are iterated over.\n"
+		"\t-k, --max-solutions=K  With --generate only count the solutions of every\n"
+		"\t                       game and print each target that has 1 to K of them\n"
+		"\t                       as \"TARGET NUMBER...: SOLUTION; ...\". Every game is\n"
+		"\t                       solved once and its search stops as soon as all\n"
+		"\t                       targets have more than K solutions. Solutions that\n"
+		"\t                       only differ in which of equal numbers they use\n"
+		"\t                       count once.\n"
+		"\t-T, --target-file=FILE Read targets from FILE instead of the TARGET argument.\n"
+		"\t                       FILE contains targets in the same format as TARGET,\n"
+		"\t                       separated by commas or whitespace. Everything after\n"
+		"\t                       a # is a comment.\n"
+		"\t-c, --checkpoint=FILE  Periodically write the outstanding work to FILE.\n"
+		"\t                       The file is removed when the search is finished.\n"
+		"\t-I, --checkpoint-interval=SECONDS\n"
+		"\t                       Write a checkpoint every SECONDS seconds. (default: 60)\n"
+		"\t-R, --resume=FILE      Continue the search stored in the checkpoint FILE.\n"
+		"\t                       TARGET and NUMBERs are read from FILE. If standard\n"
+		"\t                       output is the same regular file as before (opened for\n"
+		"\t                       appending), anything printed after the checkpoint is\n"
+		"\t                       truncated so no solution is printed twice. Any other\n"
+		"\t                       file is only appended to.\n"
+		"\t-L, --table=FILE       Answer standard games (%u numbers, targets %u to %u)\n"
+		"\t                       from the precomputed table FILE instead of searching.\n"
+		"\t                       Only one solution per target is printed, the shortest.\n"
+		"\t                       Other games are searched as usual.\n"
+		"\t-B, --build-table=FILE Build the table for --table and write it to FILE.\n"
+		"\t-S, --shard=I/N        Only search shard I (0 to N-1) of N. Running all N\n"
+		"\t                       shards, e.g. on different machines, gives exactly\n"
+		"\t                       the solutions of the whole search. Which part of the\n"
+		"\t                       search a shard gets only depends on the game and N.\n"
+		"\t-a, --anytime          Don't search exhaustively, but randomly build better\n"
+		"\t                       and better expressions until a limit is reached. Each\n"
+		"\t                       expression closer to a target than the ones before (or\n"
+		"\t                       as close and shorter) is printed with its value. Meant\n"
+		"\t                       for games too big to be solved. Uses one thread.\n"
+		"\t-s, --time-limit=SECONDS\n"
+		"\t                       Stop --anytime after SECONDS seconds. (default: 10,\n"
+		"\t                       unless --node-limit is given)\n"
+		"\t-n, --node-limit=COUNT Stop --anytime after COUNT steps. The result for a\n"
+		"\t                       given COUNT is always the same.\n"
+		"\t-G, --guided           Try larger numbers first, and operations whose result\n"
+		"\t                       is closer to a target first. The same solutions are\n"
+		"\t                       printed, but the ones near a target sooner.\n"
+		"\t-E, --estimate         Don't search, but estimate in a fraction of a second\n"
+		"\t                       how many nodes the search visits, how many solutions\n"
+		"\t                       and bytes of output it prints, and how long it takes\n"
+		"\t                       with one thread. Prints 95%% confidence intervals.\n"
+		"\n"
+		"numbers  Copyright (C) 2020  Mathias Panzenböck\n"
+		"This program comes with ABSOLUTELY NO WARRANTY.\n"
+		"This is free software, and you are welcome to redistribute it.\n"
+		"For more details see: https://github.com/panzi/numbers\n",
+		bin, bin, DEFAULT_NUMBER_COUNT,
+		DEFAULT_NUMBER_COUNT, TABLE_TARGET_START, TABLE_TARGET_END
+	);
+}
+#endif
+
+unsigned long parse_number(const char *str, const char *error_message) {
+	errno = 0;
+	char *endptr = NULL;
+	long long value = strtoll(str, &endptr, 10);
+	if (errno != 0) {
+		panice("%s: %s", error_message, str);
+	} else if (!*str || *endptr || value <= 0
+#if ULONG_MAX < LLONG_MAX
+		|| value > (long long)ULONG_MAX
+#endif
+	) {
+		panicf("%s: %s", error_message, str);
+	}
+	return (unsigned long) value;
+}
+
+// Like parse_number(), but for the numbers and targets of a game, which may
+// be bigger than an unsigned long.
+Number parse_game_number(const char *str, const char *error_message) {
+	Number value = 0;
+	const char *end = scan_number(str, &value);
+	if (!end || *end || value == 0) {
+		panicf("%s: %s", error_message, str);
+	}
+	return value;
+}
+
+// Parses I/N with 0 <= I < N.
+void parse_shard(const char *str, size_t *index, size_t *count) {
+	char *endptr = NULL;
+	errno = 0;
+	const unsigned long long shard_index = strtoull(str, &endptr, 10);
+	if (errno != 0 || endptr == str || *endptr != '/' || str[0] == '-') {
+		panicf("illegal shard, expected I/N: %s", str);
+	}
+
+	const char *count_str = endptr + 1;
+	const unsigned long long shard_count = strtoull(count_str, &endptr, 10);
+	if (errno != 0 || endptr == count_str || *endptr || count_str[0] == '-' ||
+	    shard_count == 0 || shard_count > SIZE_MAX || shard_index >= shard_count) {
+		panicf("illegal shard, expected I/N with 0 <= I < N: %s", str);
+	}
+
+	*index = shard_index;
+	*count = shard_count;
+}
+
+TargetRange parse_target_range(const char *target) {
+	TargetRange range = { .start = 100, .end = 999 };
+
+	if (!*target) {
+		panicf("target range must not be empty string");
+	}
+
+	const char *target_end = NULL;
+	if (target[0] == '.' && target[1] == '.') {
+		target_end = target + 2;
+		if (*target_end) {
+			range.end = parse_game_number(target_end, "target range end is not a valid numbers game number");
+		}
+	} else {
+		target_end = scan_number(target, &range.start);
+
+		if (!target_end || range.start == 0) {
+			panicf("target range start is not a valid numbers game number: %s", target);
+		}
+
+		if (target_end[0] == '.' && target_end[1] == '.') {
+			target_end += 2;
+			range.end = parse_game_number(target_end, "target range end is not a valid numbers game number");
+		} else if (*target_end) {
+			panicf("target range start is not a valid numbers game number: %s", target);
+		} else {
+			range.end = range.start;
+		}
+	}
+
+	return range;
+}
+
+// Adds all targets of a list like "137,412,500..600" to the set. Items may be
+// separated by commas or whitespace.
+void parse_target_set(TargetSet *targets, const char *str) {
+	const char *ptr = str;
+	// START..END
+	char item[NUMBER_DIGITS * 2 + 3];
+
+	for (;;) {
+		while (*ptr == ',' || *ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r') {
+			++ ptr;
+		}
+
+		if (!*ptr) {
+			break;
+		}
+
+		const char *item_end = ptr;
+		while (*item_end && *item_end != ',' && *item_end != ' ' && *item_end != '\t' && *item_end != '\n' && *item_end != '\r') {
+			++ item_end;
+		}
+
+		const size_t item_len = item_end - ptr;
+		if (item_len >= sizeof(item)) {
+			panicf("target is not a valid numbers game number: %.*s", (int)item_len, ptr);
+		}
+		memcpy(item, ptr, item_len);
+		item[item_len] = 0;
+
+		target_set_add(targets, parse_target_range(item));
+		ptr = item_end;
+	}
+}
+
+void load_target_file(TargetSet *targets, const char *filename) {
+	FILE *fp = fopen(filename, "r");
+	if (!fp) {
+		panice("opening target file: %s", filename);
+	}
+
+	char *line = NULL;
+	size_t line_size = 0;
+	while (getline(&line, &line_size, fp) != -1) {
+		char *comment = strchr(line, '#');
+		if (comment) {
+			*comment = 0;
+		}
+		parse_target_set(targets, line);
+	}
+
+	if (ferror(fp)) {
+		panice("reading target file: %s", filename);
+	}
+
+	free(line);
+	fclose(fp);
+}
+
+typedef struct CheckpointS {
+	Number   *numbers;
+	size_t    count;
+	Task     *tasks;
+	size_t    task_count;
+	// the file standard output was when the checkpoint was written
+	long long output_offset;
+	dev_t     output_dev;
+	ino_t     output_ino;
+} Checkpoint;
+
+static Index parse_index(const char *str, const char *error_message) {
+	if (!str) {
+		panicf("%s: missing value", error_message);
+	}
+	errno = 0;
+	char *endptr = NULL;
+	const unsigned long value = strtoul(str, &endptr, 10);
+	if (errno != 0 || !*str || *endptr || value > UINT16_MAX) {
+		panicf("%s: %s", error_message, str);
+	}
+	return (Index)value;
+}
+
+// Reads a checkpoint as written by write_checkpoint(). The targets are added
+// to the given set.
+void load_checkpoint(Checkpoint *checkpoint, TargetSet *targets, const char *filename) {
+	FILE *fp = fopen(filename, "r");
+	if (!fp) {
+		panice("opening checkpoint file: %s", filename);
+	}
+
+	*checkpoint = (Checkpoint){
+		.numbers       = NULL,
+		.count         = 0,
+		.tasks         = NULL,
+		.task_count    = 0,
+		.output_offset = -1,
+		.output_dev    = 0,
+		.output_ino    = 0,
+	};
+
+	char *line = NULL;
+	size_t line_size = 0;
+	size_t lineno = 0;
+	size_t task_capacity = 0;
+	bool has_header = false;
+	bool has_end = false;
+
+	while (!has_end && getline(&line, &line_size, fp) != -1) {
+		++ lineno;
+		char *saveptr = NULL;
+		const char *key = strtok_r(line, " \t\r\n", &saveptr);
+
+		if (!key) {
+			continue;
+		}
+
+		if (!has_header) {
+			const char *version = strtok_r(NULL, " \t\r\n", &saveptr);
+			if (strcmp(key, CHECKPOINT_MAGIC) != 0 || !version || atoi(version) != CHECKPOINT_VERSION) {
+				panicf("%s: not a supported checkpoint file", filename);
+			}
+			has_header = true;
+		} else if (strcmp(key, "targets") == 0) {
+			parse_target_set(targets, saveptr);
+		} else if (strcmp(key, "numbers") == 0) {
+			const char *item = NULL;
+			while ((item = strtok_r(NULL, " \t\r\n", &saveptr))) {
+				if (checkpoint->count == MAX_NUMBERS) {
+					panicf("%s:%zu: too many numbers", filename, lineno);
+				}
+				Number *numbers = realloc(checkpoint->numbers, (checkpoint->count + 1) * sizeof(Number));
+				if (!numbers) {
+					panice("allocating numbers array of size %zu", checkpoint->count + 1);
+				}
+				numbers[checkpoint->count ++] = parse_game_number(item, "number is not a valid numbers game number");
+				checkpoint->numbers = numbers;
+			}
+		} else if (strcmp(key, "output") == 0) {
+			const char *offset = strtok_r(NULL, " \t\r\n", &saveptr);
+			const char *dev    = strtok_r(NULL, " \t\r\n", &saveptr);
+			const char *ino    = strtok_r(NULL, " \t\r\n", &saveptr);
+			if (offset && dev && ino) {
+				checkpoint->output_offset = atoll(offset);
+				checkpoint->output_dev    = (dev_t)strtoull(dev, NULL, 10);
+				checkpoint->output_ino    = (ino_t)strtoull(ino, NULL, 10);
+			} else {
+				// without the file it can't be told which file to truncate
+				checkpoint->output_offset = -1;
+			}
+		} else if (strcmp(key, "task") == 0) {
+			if (checkpoint->count == 0) {
+				panicf("%s:%zu: task before numbers", filename, lineno);
+			}
+			const Index ops_size = checkpoint->count + checkpoint->count - 1;
+			const Index root_ops_index = parse_index(strtok_r(NULL, " \t\r\n", &saveptr), "illegal task root");
+			const Index ops_index      = parse_index(strtok_r(NULL, " \t\r\n", &saveptr), "illegal task length");
+
+			if (ops_index > ops_size || root_ops_index > ops_index) {
+				panicf("%s:%zu: illegal task", filename, lineno);
+			}
+
+			Element *ops = calloc(ops_size, sizeof(Element));
+			if (!ops) {
+				panice("allocating operand stack of size %u", ops_size);
+			}
+
+			for (Index index = 0; index < ops_index; ++ index) {
+				const char *item = strtok_r(NULL, " \t\r\n", &saveptr);
+				if (!item) {
+					panicf("%s:%zu: task is too short", filename, lineno);
+				}
+
+				switch (item[0]) {
+					case OpAdd:
+					case OpSub:
+					case OpMul:
+					case OpDiv:
+						if (item[1]) {
+							panicf("%s:%zu: illegal operation: %s", filename, lineno, item);
+						}
+						ops[index] = (Element){ .op = item[0], .index = 0, .value = 0 };
+						break;
+
+					default:
+						ops[index] = (Element){ .op = OpVal, .index = parse_index(item, "illegal number index"), .value = 0 };
+				}
+			}
+
+			if (checkpoint->task_count == task_capacity) {
+				task_capacity = task_capacity == 0 ? 16 : task_capacity * 2;
+				Task *tasks = realloc(checkpoint->tasks, task_capacity * sizeof(Task));
+				if (!tasks) {
+					panice("allocating tasks of size %zu", task_capacity);
+				}
+				checkpoint->tasks = tasks;
+			}
+
+			checkpoint->tasks[checkpoint->task_count ++] = (Task){
+				.ops            = ops,
+				.root_ops_index = root_ops_index,
+				.ops_index      = ops_index,
+			};
+		} else if (strcmp(key, "end") == 0) {
+			has_end = true;
+		} else {
+			panicf("%s:%zu: unknown key: %s", filename, lineno, key);
+		}
+	}
+
+	if (ferror(fp)) {
+		panice("reading checkpoint file: %s", filename);
+	}
+
+	if (!has_end) {
+		panicf("%s: checkpoint file is truncated", filename);
+	}
+
+	if (checkpoint->count == 0) {
+		panicf("%s: checkpoint file has no numbers", filename);
+	}
+
+	free(line);
+	fclose(fp);
+}
+
+#ifndef NUMBERS_NO_MAIN
+// Cut off anything that was printed after the checkpoint was written, so no
+// solution is printed twice. Only possible if the output is a regular file,
+// and only done if it is the same file as when the checkpoint was written.
+// Any other file is appended to.
+static void restore_output_offset(const Checkpoint *checkpoint) {
+	const long long output_offset = checkpoint->output_offset;
+	struct stat info;
+	if (output_offset < 0 || fstat(fileno(stdout), &info) != 0 || !S_ISREG(info.st_mode)) {
+		return;
+	}
+
+	if (info.st_dev != checkpoint->output_dev || info.st_ino != checkpoint->output_ino) {
+		fprintf(stderr, "warning: output is not the file the checkpoint was written for, appending to it\n");
+		return;
+	}
+
+	if (info.st_size < output_offset) {
+		fprintf(stderr, "warning: output file is shorter than when the checkpoint was written\n");
+		return;
+	}
+
+	if (ftruncate(fileno(stdout), output_offset) != 0) {
+		panice("truncating output file to %lld bytes", output_offset);
+	}
+
+	if (fseeko(stdout, output_offset, SEEK_SET) != 0) {
+		panice("seeking output file to %lld", output_offset);
+	}
+}
+#endif
+
+// Hard puzzles: With --max-solutions=K every game of --generate only counts
+// its solutions per target and keeps the first K of each. After the game is
+// solved the targets with 1 to K solutions are printed. Once every target has
+// more than K solutions nothing of the game can be printed anymore, so the
+// rest of its search is cut off by setting prune_log to its maximum: every
+// subtree is then pruned by the bound test that is done anyway.
+
+#define HARD_MAX_TARGET_SPAN 65536
+
+typedef struct HardGameS {
+	size_t *counts;
+	char   *solutions;
+	size_t  over_count;
+} HardGame;
+
+typedef struct HardSearchS {
+	const TargetSet *targets;
+	size_t           max_solutions;
+	size_t           target_span;
+	size_t           target_count;
+	size_t           solution_size;
+	// one per slot, see generate()
+	HardGame        *games;
+} HardSearch;
+
+static inline char *hard_solution(const HardSearch *search, const HardGame *game, const size_t target_index, const size_t index) {
+	return game->solutions + (target_index * search->max_solutions + index) * search->solution_size;
+}
+
+static void hard_record_solution(NumbersCtx *ctx, const Number result) {
+	const HardSearch *search = ctx->sink_data;
+	HardGame *game = &search->games[ctx->slot];
+	const size_t target_index = result - search->targets->min;
+	const size_t count = ++ game->counts[target_index];
+
+	if (count <= search->max_solutions) {
+		char *end = format_solution(ctx, hard_solution(search, game, target_index, count - 1));
+		*end = 0;
+	} else if (count == search->max_solutions + 1 && ++ game->over_count == search->target_count) {
+		ctx->prune_log = ~(LogBound)0;
+	}
+}
+
+// Prints the targets of the game that have at most max_solutions solutions
+// as "TARGET NUMBER...: SOLUTION; SOLUTION..." and resets the counts.
+static void hard_game_done(NumbersCtx *ctx) {
+	const HardSearch *search = ctx->sink_data;
+	HardGame *game = &search->games[ctx->slot];
+
+	int errnum = pthread_mutex_lock(&ctx->mngr->iolock);
+	if (errnum != 0) {
+		panicf("locking io mutex: %s", strerror(errnum));
+	}
 
-		if (generate) {
-			Number *numbers = calloc(count, sizeof(Number));
-			if (!numbers) {
-				panice("allocating numbers array of size %" PRII, count);
+	for (size_t target_index = 0; target_index < search->target_span; ++ target_index) {
+		const size_t count = game->counts[target_index];
+		if (count > 0 && count <= search->max_solutions) {
+			fprint_number(stdout, search->targets->min + (Number)target_index);
+			for (Index index = 0; index < ctx->count; ++ index) {
+				putchar(' ');
+				fprint_number(stdout, ctx->numbers[index]);
 			}
-			solver->numbers = numbers;
-		}
-
-		if (sem_init(&solver->semaphore, 0, 0) != 0) {
-			panice("initializing semaphore of worker thread %zu", thread_index);
+			for (size_t index = 0; index < count; ++ index) {
+				printf("%s%s", index == 0 ? ": " : "; ", hard_solution(search, game, target_index, index));
+			}
+			putchar('\n');
 		}
+	}
 
-		int errnum = pthread_create(&solver->thread, NULL, worker_proc, solver);
-		if (errnum != 0) {
-			panicf("starting worker thread %zu: %s", thread_index, strerror(errnum));
-		}
+	errnum = pthread_mutex_unlock(&ctx->mngr->iolock);
+	if (errnum != 0) {
+		panicf("unlocking io mutex: %s", strerror(errnum));
 	}
+
+	memset(game->counts, 0, search->target_span * sizeof(size_t));
+	game->over_count = 0;
 }
 
-void thread_manager_destroy(ThreadManager *mngr) {
-	for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
-		NumbersCtx *solver = &mngr->solvers[thread_index];
+void hard_search_create(HardSearch *search, ThreadManager *mngr, const TargetSet *targets, const size_t max_solutions) {
+	if (targets->max - targets->min >= HARD_MAX_TARGET_SPAN) {
+		panicf("--max-solutions supports targets spanning at most %d numbers", HARD_MAX_TARGET_SPAN);
+	}
 
-		if (solver->alive) {
-			solver->alive = false;
+	*search = (HardSearch){
+		.targets       = targets,
+		.max_solutions = max_solutions,
+		.target_span   = targets->max - targets->min + 1,
+		.target_count  = 0,
+		.solution_size = SOLUTION_BUFFER_SIZE(mngr->solvers[0].ops_size),
+		.games         = NULL,
+	};
 
-			if (sem_post(&solver->semaphore) != 0) {
-				panice("posting to semaphore of worker thread %zu", thread_index);
-			}
-		}
+	for (size_t index = 0; index < targets->count; ++ index) {
+		search->target_count += targets->ranges[index].end - targets->ranges[index].start + 1;
 	}
 
-	int errnum = 0;
-	for (size_t thread_index = 0; thread_index < mngr->thread_count; ++ thread_index) {
-		NumbersCtx *solver = &mngr->solvers[thread_index];
+	search->games = calloc(mngr->slot_count, sizeof(HardGame));
+	if (!search->games) {
+		panice("allocating hard puzzle state of %zu games", mngr->slot_count);
+	}
 
-		errnum = pthread_join(solver->thread, NULL);
-		if (errnum != 0) {
-			fprintf(stderr, "wating for worker thread %zu to end: %s\n", thread_index, strerror(errnum));
-		}
+	for (size_t slot = 0; slot < mngr->slot_count; ++ slot) {
+		HardGame *game = &search->games[slot];
 
-		if (sem_destroy(&solver->semaphore) != 0) {
-			fprintf(stderr, "freeing semaphore of worker thread %zu: %s\n", thread_index, strerror(errno));
+		game->counts = calloc(search->target_span, sizeof(size_t));
+		if (!game->counts) {
+			panice("allocating solution counts of size %zu", search->target_span);
 		}
 
-		free(solver->ops);
-		free(solver->vals);
-
-		if (mngr->generate) {
-			free((void*)solver->numbers);
+		game->solutions = malloc(search->target_span * max_solutions * search->solution_size);
+		if (!game->solutions) {
+			panice("allocating %zu solutions of %zu targets", max_solutions, search->target_span);
 		}
 	}
 
-	free(mngr->solvers);
+	mngr->sink      = hard_record_solution;
+	mngr->distinct  = true;
+	mngr->game_done = hard_game_done;
+}
 
-	if (sem_destroy(&mngr->semaphore) != 0) {
-		panice("freeing semaphore of thread manager");
+void hard_search_destroy(HardSearch *search, const ThreadManager *mngr) {
+	for (size_t slot = 0; slot < mngr->slot_count; ++ slot) {
+		free(search->games[slot].counts);
+		free(search->games[slot].solutions);
 	}
+	free(search->games);
+	search->games = NULL;
+}
 
-	errnum = pthread_mutex_destroy(&mngr->worker_lock);
-	if (errnum != 0) {
-		panicf("destroying io mutex: %s", strerror(errnum));
-	}
+// Plain --generate: The solutions of every game are collected as text in the
+// buffer of its slot and printed together with the line naming the game once
+// it is solved. So the lines of a game stay together no matter how many games
+// are in flight, and the games can be solved in batches. NUMBERS[] has two of
+// most cards, so most games can be selected in several ways (134596 ways for
+// 13243 games of 6 numbers). Every game is only solved once and its lines are
+// printed once per way to select it.
+
+typedef struct GenerateTextS {
+	char   *text;
+	size_t  size;
+	size_t  capacity;
+} GenerateText;
+
+typedef struct GeneratePrintS {
+	const TargetSet *targets;
+	// one per slot, see generate()
+	GenerateText    *games;
+} GeneratePrint;
+
+static void generate_record_solution(NumbersCtx *ctx, const Number result) {
+	const GeneratePrint *print = ctx->sink_data;
+	GenerateText *game = &print->games[ctx->slot];
+	const size_t line_size = SOLUTION_BUFFER_SIZE(ctx->ops_index);
+
+	if (game->capacity - game->size < line_size) {
+		size_t capacity = game->capacity > 0 ? game->capacity : 4096;
+		while (capacity - game->size < line_size) {
+			capacity *= 2;
+		}
 
-	errnum = pthread_mutex_destroy(&mngr->iolock);
-	if (errnum != 0) {
-		panicf("destroying io mutex: %s", strerror(errnum));
+		char *text = realloc(game->text, capacity);
+		if (!text) {
+			panice("allocating solutions text of size %zu", capacity);
+		}
+		game->text     = text;
+		game->capacity = capacity;
 	}
-}
 
-static void usage(int argc, char *const argv[]) {
-	const char *bin = argc > 0 ? argv[0] : "numbers";
-	printf("Usage: %s [OPTIONS] TARGET NUMBER...\n", bin);
-	printf("       %s --generate [TARGET]\n", bin);
-	printf(
-		"\n"
-		"TARGET may be a single number or an inclusive range in the form START..END.\n"
-		"\n"
-		"EXAMPLE:\n"
-		"\n"
-		"\t%s 100..200 1 2 3 25 50 75\n"
-		"\n"
-		"OPTIONS:\n"
-		"\n"
-		"\t-h, --help             Print this help message.\n"
-#ifdef HAS_GET_CPU_COUNT
-		"\t-t, --threads=COUNT    Spawn COUNT threads. (default: cpus)\n"
-#else
-		"\t-t, --threads=COUNT    Spawn COUNT threads. (default: numbers)\n"
-#endif
-		"\n"
-		"\t                       Special COUNT values:\n"
-#ifdef HAS_GET_CPU_COUNT
-		"\t                          cpus ...... use number of CPUs (CPU cores)\n"
-#endif
-		"\t                          numbers ... use number count\n"
-		"\n"
-		"\t                       Note: If more than 1 thread is used the order of the\n"
-		"\t                       results is random.\n"
-		"\n"
-		"\t-r, --rpn              Print solutions in reverse Polish notation.\n"
-		"\t-e, --expr             Print solutions in usual notation (default).\n"
-		"\t-p, --paren            Like --expr but never skip parenthesis.\n"
-		"\t-g, --generate         Generate standard numbers games with %u numbers and\n"
-		"\t                       their solutions. If no target is given all targets\n"
-		"\t                       from 100 to 999 are iterated over.\n"
-		"\n"
-		"numbers  Copyright (C) 2020  Mathias Panzenböck\n"
-		"This program comes with ABSOLUTELY NO WARRANTY.\n"
-		"This is free software, and you are welcome to redistribute it.\n"
-		"For more details see: https://github.com/panzi/numbers\n",
-		bin, DEFAULT_NUMBER_COUNT
-	);
+	const char *end = format_solution_line(ctx, result, !target_set_is_single(print->targets), game->text + game->size);
+	game->size = end - game->text;
 }
 
-unsigned long parse_number(const char *str, const char *error_message) {
-	errno = 0;
-	char *endptr = NULL;
-	long long value = strtoll(str, &endptr, 10);
-	if (errno != 0) {
-		panice("%s: %s", error_message, str);
-	} else if (!*str || *endptr || value <= 0
-#if ULONG_MAX < LLONG_MAX
-		|| value > (long long)ULONG_MAX
-#endif
-	) {
-		panicf("%s: %s", error_message, str);
+// How many ways there are to select the numbers out of NUMBERS[]. Equal
+// numbers are next to each other, because they are selected in the order of
+// NUMBERS[].
+static size_t generate_selection_count(const Number numbers[], const Index count) {
+	size_t selections = 1;
+	for (Index index = 0; index < count;) {
+		const Number value = numbers[index];
+		size_t game_count = 0;
+		for (; index < count && numbers[index] == value; ++ index) {
+			++ game_count;
+		}
+
+		size_t pool_count = 0;
+		for (size_t pool_index = 0; pool_index < sizeof(NUMBERS) / sizeof(Number); ++ pool_index) {
+			if (NUMBERS[pool_index] == value) {
+				++ pool_count;
+			}
+		}
+
+		// binomial(pool_count, game_count)
+		for (size_t chosen = 0; chosen < game_count; ++ chosen) {
+			selections = selections * (pool_count - chosen) / (chosen + 1);
+		}
 	}
-	return (unsigned long) value;
+	return selections;
 }
 
-TargetRange parse_target_range(const char *target) {
-	TargetRange range = { .start = 100, .end = 999 };
+// Prints "TARGET=... NUMBERS=[...]" and the solutions of the game, once per
+// way to select the game.
+static void generate_game_done(NumbersCtx *ctx) {
+	const GeneratePrint *print = ctx->sink_data;
+	GenerateText *game = &print->games[ctx->slot];
+	const size_t selections = generate_selection_count(ctx->numbers, ctx->count);
 
-	if (!*target) {
-		panicf("target range must not be empty string");
+	int errnum = pthread_mutex_lock(&ctx->mngr->iolock);
+	if (errnum != 0) {
+		panicf("locking io mutex: %s", strerror(errnum));
 	}
 
-	const char *target_end = NULL;
-	if (target[0] == '.' && target[1] == '.') {
-		target_end = target + 2;
-		if (*target_end) {
-			range.end = parse_number(target_end, "target range end is not a valid numbers game number");
+	for (size_t selection = 0; selection < selections; ++ selection) {
+		printf("TARGET=");
+		print_target_set(stdout, print->targets);
+		printf(" NUMBERS=[");
+		for (Index index = 0; index < ctx->count; ++ index) {
+			if (index > 0) {
+				printf(", ");
+			}
+			fprint_number(stdout, ctx->numbers[index]);
 		}
-	} else {
-		errno = 0;
-		long long value = strtoll(target, (char**)&target_end, 10);
+		printf("]\n");
+		fwrite(game->text, 1, game->size, stdout);
+	}
 
-		if (errno != 0) {
-			panice("target range start is not a valid numbers game number: %s", target);
-		} else if (value <= 0
-#if ULONG_MAX < LLONG_MAX
-			|| value > (long long)ULONG_MAX
-#endif
-		) {
-			panicf("target range start is not a valid numbers game number: %s", target);
-		}
+	errnum = pthread_mutex_unlock(&ctx->mngr->iolock);
+	if (errnum != 0) {
+		panicf("unlocking io mutex: %s", strerror(errnum));
+	}
 
-		range.start = value;
+	game->size = 0;
+}
 
-		if (target_end[0] == '.' && target_end[1] == '.') {
-			target_end += 2;
-			range.end = parse_number(target_end, "target range end is not a valid numbers game number");
-		} else if (*target_end) {
-			panicf("target range start is not a valid numbers game number: %s", target);
-		} else {
-			range.end = range.start;
-		}
+void generate_print_create(GeneratePrint *print, ThreadManager *mngr, const TargetSet *targets) {
+	*print = (GeneratePrint){
+		.targets = targets,
+		.games   = calloc(mngr->slot_count, sizeof(GenerateText)),
+	};
+
+	if (!print->games) {
+		panice("allocating solutions text of %zu games", mngr->slot_count);
 	}
 
-	return range;
+	mngr->sink      = generate_record_solution;
+	mngr->game_done = generate_game_done;
 }
 
-void select_and_solve(ThreadManager *mngr, Number numbers[], size_t number_index, size_t selection_index_start, TargetRange target) {
-	if (number_index == mngr->number_count) {
-		if (target.start == target.end) {
-			printf("TARGET=%" PRIN " ", target.start);
-		} else {
-			printf("TARGET=%" PRIN "..%" PRIN " ", target.start, target.end);
-		}
-		printf("NUMBERS=[%" PRIN ", %" PRIN ", %" PRIN ", %" PRIN ", %" PRIN ", %" PRIN "]\n",
-			numbers[0], numbers[1], numbers[2], numbers[3], numbers[4], numbers[5]);
+void generate_print_destroy(GeneratePrint *print, const ThreadManager *mngr) {
+	for (size_t slot = 0; slot < mngr->slot_count; ++ slot) {
+		free(print->games[slot].text);
+	}
+	free(print->games);
+	print->games = NULL;
+}
 
-		// TODO: Each thread only has < 50% CPU usage. Maybe because solve()
-		//       actually only takes a tiny amount of time and most of the time is
-		//       spent creating and joining threads?
-		generate(mngr, target, numbers);
+// Every game is only solved once, even though NUMBERS[] has duplicates.
+void select_and_solve(ThreadManager *mngr, Number numbers[], size_t number_index, size_t selection_index_start, const TargetSet *targets, void *sink_data) {
+	if (number_index == mngr->number_count) {
+		generate(mngr, targets, numbers, sink_data);
 	} else {
 		for (size_t selection_index = selection_index_start; selection_index < (sizeof(NUMBERS) / sizeof(Number));) {
+			// games with the same cards are equal
+			if (selection_index > selection_index_start && NUMBERS[selection_index] == NUMBERS[selection_index - 1]) {
+				++ selection_index;
+				continue;
+			}
 			numbers[number_index] = NUMBERS[selection_index];
-			select_and_solve(mngr, numbers, number_index + 1, ++ selection_index, target);
+			select_and_solve(mngr, numbers, number_index + 1, ++ selection_index, targets, sink_data);
 		}
 	}
 }
 
+// src/verify.c includes this file and brings its own main().
+#ifndef NUMBERS_NO_MAIN
 int main(int argc, char *argv[]) {
 	struct option long_options[] = {
 		{"help",     no_argument,       0, 'h'},
@@ -872,13 +4262,41 @@ int main(int argc, char *argv[]) {
 		{"expr",     no_argument,       0, 'e'},
 		{"paren",    no_argument,       0, 'p'},
 		{"generate", no_argument,       0, 'g'},
+		{"target-file", required_argument, 0, 'T'},
+		{"checkpoint",  required_argument, 0, 'c'},
+		{"checkpoint-interval", required_argument, 0, 'I'},
+		{"resume",      required_argument, 0, 'R'},
+		{"table",       required_argument, 0, 'L'},
+		{"build-table", required_argument, 0, 'B'},
+		{"anytime",     no_argument,       0, 'a'},
+		{"time-limit",  required_argument, 0, 's'},
+		{"node-limit",  required_argument, 0, 'n'},
+		{"shard",       required_argument, 0, 'S'},
+		{"max-solutions", required_argument, 0, 'k'},
+		{"estimate",    no_argument,       0, 'E'},
+		{"guided",      no_argument,       0, 'G'},
 		{0,          0,                 0,  0 },
 	};
 
 	PrintStyle print_style = PrintExpr;
 	size_t threads = 0;
 	bool generate = false;
-
+	const char *target_file = NULL;
+	const char *checkpoint_file = NULL;
+	const char *resume_file = NULL;
+	const char *table_file = NULL;
+	const char *build_table_file = NULL;
+	bool anytime = false;
+	bool estimate = false;
+	bool guided = false;
+	unsigned long time_limit = 0;
+	unsigned long node_limit = 0;
+	size_t shard_index = 0;
+	size_t shard_count = 0;
+	size_t max_solutions = 0;
+	unsigned int checkpoint_interval = 60;
+
+	bool threads_auto = true;
 #ifdef HAS_GET_CPU_COUNT
 	bool threads_from_numbers = false;
 #else
@@ -886,7 +4304,7 @@ int main(int argc, char *argv[]) {
 #endif
 
 	for(;;) {
-		int c = getopt_long(argc, argv, "ht:rep", long_options, NULL);
+		int c = getopt_long(argc, argv, "ht:repgT:c:I:R:L:B:as:n:S:k:EG", long_options, NULL);
 		if (c == -1)
 			break;
 
@@ -908,13 +4326,19 @@ int main(int argc, char *argv[]) {
 				break;
 
 			case 't':
-				if (strcasecmp(optarg, "numbers") == 0) {
+				if (strcasecmp(optarg, "auto") == 0) {
+					threads_auto = true;
+					threads = 0;
+				} else if (strcasecmp(optarg, "numbers") == 0) {
+					threads_auto = false;
 					threads_from_numbers = true;
 					threads = 0;
 				} else if (strcasecmp(optarg, "cpus") == 0) {
+					threads_auto = false;
 					threads_from_numbers = false;
 					threads = 0;
 				} else {
+					threads_auto = false;
 					threads = parse_number(optarg, "illegal thread count");
 				}
 				break;
@@ -923,6 +4347,58 @@ int main(int argc, char *argv[]) {
 				generate = true;
 				break;
 
+			case 'T':
+				target_file = optarg;
+				break;
+
+			case 'c':
+				checkpoint_file = optarg;
+				break;
+
+			case 'I':
+				checkpoint_interval = parse_number(optarg, "illegal checkpoint interval");
+				break;
+
+			case 'R':
+				resume_file = optarg;
+				break;
+
+			case 'L':
+				table_file = optarg;
+				break;
+
+			case 'B':
+				build_table_file = optarg;
+				break;
+
+			case 'a':
+				anytime = true;
+				break;
+
+			case 's':
+				time_limit = parse_number(optarg, "illegal time limit");
+				break;
+
+			case 'n':
+				node_limit = parse_number(optarg, "illegal node limit");
+				break;
+
+			case 'S':
+				parse_shard(optarg, &shard_index, &shard_count);
+				break;
+
+			case 'k':
+				max_solutions = parse_number(optarg, "illegal solution count");
+				break;
+
+			case 'E':
+				estimate = true;
+				break;
+
+			case 'G':
+				guided = true;
+				break;
+
 			case '?':
 				usage(argc, argv);
 				return 1;
@@ -930,18 +4406,92 @@ int main(int argc, char *argv[]) {
 	}
 
 	size_t count = argc - optind;
+	TargetSet targets;
+	target_set_create(&targets);
+	Checkpoint resume = { .numbers = NULL, .count = 0, .tasks = NULL, .task_count = 0, .output_offset = -1 };
 
-	if (generate) {
-		if (count > 1) {
+	if (generate && (checkpoint_file || resume_file)) {
+		panicf("--checkpoint and --resume are not supported with --generate");
+	}
+
+	if ((generate || resume_file) && table_file) {
+		panicf("--table is not supported with --generate or --resume");
+	}
+
+	if (build_table_file && (generate || resume_file || target_file || checkpoint_file || table_file)) {
+		panicf("--build-table can't be combined with other modes");
+	}
+
+	if (anytime && (generate || resume_file || build_table_file || checkpoint_file || table_file)) {
+		panicf("--anytime can't be combined with other modes");
+	}
+
+	if (estimate && (generate || resume_file || build_table_file || checkpoint_file || table_file || anytime || shard_count > 0)) {
+		panicf("--estimate can't be combined with other modes");
+	}
+
+	if (guided && (generate || resume_file || build_table_file || checkpoint_file || table_file || anytime || estimate || shard_count > 0)) {
+		panicf("--guided can't be combined with --generate, --resume, --build-table, --checkpoint, --table, --anytime, --estimate, or --shard");
+	}
+
+	if (max_solutions > 0 && !generate) {
+		panicf("--max-solutions needs --generate");
+	}
+
+	if (shard_count > 0 && (generate || resume_file || build_table_file || table_file || anytime)) {
+		panicf("--shard can only be combined with --checkpoint");
+	}
+
+	if (!anytime && (time_limit || node_limit)) {
+		panicf("--time-limit and --node-limit need --anytime");
+	}
+
+	if (anytime && !time_limit && !node_limit) {
+		time_limit = 10;
+	}
+
+	if (target_file) {
+		if (resume_file) {
+			panicf("--target-file can't be used with --resume");
+		}
+		load_target_file(&targets, target_file);
+	}
+
+	if (resume_file) {
+		if (count > 0) {
+			panicf("too many arguments, TARGET and NUMBERs are read from the checkpoint file");
+		}
+
+		load_checkpoint(&resume, &targets, resume_file);
+		count = resume.count;
+	} else if (build_table_file) {
+		if (count > 0) {
+			panicf("too many arguments");
+		}
+		count = DEFAULT_NUMBER_COUNT;
+	} else if (generate) {
+		if (count > (target_file ? 0 : 1)) {
 			panicf("too many arguments");
 		}
+
+		if (optind < argc) {
+			parse_target_set(&targets, argv[optind]);
+			++ optind;
+		} else if (!target_file) {
+			target_set_add(&targets, (TargetRange){ .start = 100, .end = 999 });
+		}
 		count = DEFAULT_NUMBER_COUNT;
 	} else {
-		if (count == 0) {
-			panicf("argument TARGET is missing");
+		if (!target_file) {
+			if (count == 0) {
+				panicf("argument TARGET is missing");
+			}
+
+			parse_target_set(&targets, argv[optind]);
+			++ optind;
+			-- count;
 		}
 
-		-- count;
 		if (count == 0) {
 			panicf("need at least one NUMBER argument");
 		}
@@ -963,57 +4513,121 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	if (build_table_file) {
+		build_table(build_table_file, threads);
+		return 0;
+	}
+
 	Number *numbers = calloc(count, sizeof(Number));
 	if (!numbers) {
 		panice("allocating numbers array of size %zu", count);
 	}
 
-	ThreadManager mngr;
-	thread_manager_create(&mngr, count, threads, print_style, generate);
-
-	if (generate) {
-		TargetRange target = { .start = 100, .end = 999 };
+	target_set_normalize(&targets);
 
-		if (optind < argc) {
-			target = parse_target_range(argv[optind]);
+	if (!generate && !resume_file) {
+		for (int index = optind; index < argc; ++ index) {
+			const Number number = parse_game_number(argv[index], "number is not a valid numbers game number");
+			numbers[index - optind] = number;
 		}
+	}
 
-		// XXX: --generate needs to be written differntly, because TARGET=100 with
-		//      NUMBERS=[100, a, b, c, d, e] has 1287 solutions that are all just the nubmer 100.
-		select_and_solve(&mngr, numbers, 0, 0, target);
+	if (table_file) {
+		Table table;
+		table_open(&table, table_file);
+		const bool solved = table_solve(&table, print_style, &targets, numbers, count);
+		table_close(&table);
 
-		for (;;) {
-			size_t thread_index = 0;
-			for (thread_index = 0; thread_index < mngr.thread_count; ++ thread_index) {
-				NumbersCtx *solver = &mngr.solvers[thread_index];
+		if (solved) {
+			target_set_destroy(&targets);
+			free(numbers);
+			return 0;
+		}
+	}
 
-				if (solver->active) {
-					break;
-				}
-			}
+	if (anytime) {
+		anytime_search(&targets, numbers, count, print_style, time_limit, node_limit);
+		target_set_destroy(&targets);
+		free(numbers);
+		return 0;
+	}
 
-			if (thread_index < mngr.thread_count) {
-				if (sem_wait(&mngr.semaphore) != 0) {
-					panice("waiting on thread manager semaphore");
-				}
-			} else {
-				break;
-			}
+	if (estimate) {
+		Estimate result;
+		estimate_search(&result, &targets, numbers, count, print_style);
+		print_estimate(&result);
+		target_set_destroy(&targets);
+		free(numbers);
+		return 0;
+	}
+
+	// the numbers of a resumed checkpoint are not known yet and --generate
+	// solves many games, so only a single search is planned
+	Plan plan = { .threads = threads, .split_count = 0, .nodes = 0 };
+	const bool planned = !generate && !resume_file;
+	if (planned) {
+		plan_search(&plan, &targets, numbers, count, threads, shard_count > 0 ? shard_count : 1);
+		if (threads_auto) {
+			threads = plan.threads;
 		}
+	}
 
-	} else {
-		TargetRange target = parse_target_range(argv[optind]);
-		++ optind;
+	ThreadManager mngr;
+	thread_manager_create(&mngr, count, threads, print_style, generate);
 
-		for (int index = optind; index < argc; ++ index) {
-			const Number number = parse_number(argv[index], "number is not a valid numbers game number");
-			numbers[index - optind] = number;
+	mngr.checkpoint_file     = checkpoint_file;
+	mngr.checkpoint_interval = checkpoint_interval;
+	mngr.guided              = guided;
+	if (planned) {
+		mngr.split_count = plan.split_count;
+	}
+
+	if (generate) {
+		// XXX: --generate needs to be written differntly, because TARGET=100 with
+		//      NUMBERS=[100, a, b, c, d, e] has 1287 solutions that are all just the nubmer 100.
+		if (max_solutions > 0) {
+			HardSearch search;
+			hard_search_create(&search, &mngr, &targets, max_solutions);
+			mngr.batch = true;
+			select_and_solve(&mngr, numbers, 0, 0, &targets, &search);
+			generate_wait(&mngr);
+			hard_search_destroy(&search, &mngr);
+		} else {
+			GeneratePrint print;
+			generate_print_create(&print, &mngr, &targets);
+			mngr.batch = true;
+			select_and_solve(&mngr, numbers, 0, 0, &targets, &print);
+			generate_wait(&mngr);
+			generate_print_destroy(&print, &mngr);
 		}
 
-		solve(&mngr, target, numbers);
+	} else if (resume_file) {
+		memcpy(numbers, resume.numbers, count * sizeof(Number));
+		free(resume.numbers);
+
+		// the thread manager takes ownership of the tasks
+		mngr.tasks      = resume.tasks;
+		mngr.task_count = resume.task_count;
+
+		restore_output_offset(&resume);
+
+		if (mngr.task_count > 0) {
+			solve(&mngr, &targets, numbers);
+		} else if (checkpoint_file && unlink(checkpoint_file) != 0 && errno != ENOENT) {
+			panice("removing checkpoint file: %s", checkpoint_file);
+		}
+	} else if (shard_count > 0) {
+		prepare_shard(&mngr, &targets, numbers, shard_index, shard_count);
+		if (mngr.task_count > 0) {
+			solve(&mngr, &targets, numbers);
+		}
+	} else {
+		solve(&mngr, &targets, numbers);
 	}
 	thread_manager_destroy(&mngr);
+	target_set_destroy(&targets);
 	free(numbers);
 
 	return 0;
 }
+#endif
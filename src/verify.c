@@ -0,0 +1,651 @@
+/**
+ *    numbers - a countdown numbers game solver
+ *    Copyright (C) 2020  Mathias Panzenböck
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Randomized verification of the solver in the same process: Like test.py it
+// generates random games from a random expression, so there is a known
+// solution, but the solutions are checked by a solution sink instead of
+// printing and parsing them. Every solution is evaluated again and has to
+// use each number at most once, have only positive whole intermediate
+// results, and hit a target. At least one solution has to hit the target of
+// the expression the game was generated from. Every few games the same game
+// is also solved with several threads that hand off work at every depth,
+// alone and in the --guided order, split into shards, and (for games of
+// DEFAULT_NUMBER_COUNT numbers) with the --generate workers, alone and in a
+// batch together with other games, and all have to find exactly the same
+// solutions. Counting distinct solutions like --max-solutions, they have to
+// find each solution of a game with equal numbers only once.
+#define NUMBERS_NO_MAIN
+#include "numbers.c"
+
+#define VERIFY_MAX_COUNT       7
+#define VERIFY_SMALL_NUMBER    10
+#define VERIFY_MAX_NUMBER      500
+#define VERIFY_MAX_TARGET      999
+#define VERIFY_MAX_RANGE       50
+#define VERIFY_DEFAULT_SECONDS 60
+#define VERIFY_CROSS_CHECK     16
+#define VERIFY_MAX_SHARDS      4
+
+typedef struct VerifyGameS {
+	Index     count;
+	Number    numbers[VERIFY_MAX_COUNT];
+	Number    target;
+	TargetSet targets;
+	Element   code[VERIFY_MAX_COUNT * 2 - 1];
+	Index     code_size;
+} VerifyGame;
+
+// Solutions found by one engine. The solutions are compared by count and by
+// the sum and xor of their hashes, which doesn't depend on the order in
+// which threads find them. Updated atomically, since the sink is called by
+// all workers.
+typedef struct VerifyResultS {
+	const VerifyGame *game;
+	const char       *engine;
+	size_t            solution_count;
+	uint64_t          hash_sum;
+	uint64_t          hash_xor;
+	size_t            target_hits;
+	size_t            error_count;
+	// only the solutions that use equal numbers in the order they are given,
+	// which are the ones of a search with mngr->distinct
+	size_t            distinct_count;
+	uint64_t          distinct_sum;
+	uint64_t          distinct_xor;
+} VerifyResult;
+
+static uint64_t verify_hash(const Element ops[], const Index ops_size) {
+	// FNV-1a
+	uint64_t hash = UINT64_C(0xcbf29ce484222325);
+	for (Index index = 0; index < ops_size; ++ index) {
+		hash ^= ops[index].op == OpVal ? (uint64_t)ops[index].index + 256 : (uint64_t)ops[index].op;
+		hash *= UINT64_C(0x100000001b3);
+	}
+	return hash;
+}
+
+static void verify_print_game(FILE *stream, const VerifyGame *game) {
+	print_target_set(stream, &game->targets);
+	for (Index index = 0; index < game->count; ++ index) {
+		fputc(' ', stream);
+		fprint_number(stream, game->numbers[index]);
+	}
+	fprintf(stream, " (generated from:");
+	for (Index index = 0; index < game->code_size; ++ index) {
+		fputc(' ', stream);
+		if (game->code[index].op == OpVal) {
+			fprint_number(stream, game->code[index].value);
+		} else {
+			fputc(game->code[index].op, stream);
+		}
+	}
+	fprintf(stream, ")\n");
+}
+
+static void verify_fail(NumbersCtx *ctx, VerifyResult *result, const char *message) {
+	char buf[SOLUTION_BUFFER_SIZE(ctx->ops_index)];
+	*format_solution_rpn(ctx, buf) = 0;
+
+	int errnum = pthread_mutex_lock(&ctx->mngr->iolock);
+	if (errnum != 0) {
+		panicf("locking io mutex: %s", strerror(errnum));
+	}
+
+	fprintf(stderr, "%s: %s: %s\n    game: ", result->engine, message, buf);
+	verify_print_game(stderr, result->game);
+
+	errnum = pthread_mutex_unlock(&ctx->mngr->iolock);
+	if (errnum != 0) {
+		panicf("unlocking io mutex: %s", strerror(errnum));
+	}
+
+	__atomic_add_fetch(&result->error_count, 1, __ATOMIC_RELAXED);
+}
+
+// Evaluates the solution again without any of the rules of the solver.
+static void verify_solution(NumbersCtx *ctx, const Number value) {
+	VerifyResult *result = ctx->sink_data;
+	const VerifyGame *game = result->game;
+	Number stack[VERIFY_MAX_COUNT];
+	Index stack_size = 0;
+	size_t used_mask = 0;
+	bool distinct = true;
+
+	for (Index index = 0; index < ctx->ops_index; ++ index) {
+		const Element *elem = &ctx->ops[index];
+		if (elem->op == OpVal) {
+			const size_t mask = (size_t)1 << elem->index;
+			if (elem->index >= game->count || elem->value != game->numbers[elem->index]) {
+				verify_fail(ctx, result, "not a number of the game");
+				return;
+			}
+			if (used_mask & mask) {
+				verify_fail(ctx, result, "number used twice");
+				return;
+			}
+			for (Index other = 0; other < elem->index; ++ other) {
+				if (game->numbers[other] == elem->value && !(used_mask & ((size_t)1 << other))) {
+					distinct = false;
+				}
+			}
+			used_mask |= mask;
+			stack[stack_size ++] = elem->value;
+			continue;
+		}
+
+		if (stack_size < 2) {
+			verify_fail(ctx, result, "stack underflow");
+			return;
+		}
+
+		const Number lhs = stack[stack_size - 2];
+		const Number rhs = stack[stack_size - 1];
+		Number intermediate = 0;
+		bool legal = true;
+		switch (elem->op) {
+			case OpAdd: legal = !__builtin_add_overflow(lhs, rhs, &intermediate); break;
+			case OpSub: legal = lhs > rhs; intermediate = lhs - rhs; break;
+			case OpMul: legal = !__builtin_mul_overflow(lhs, rhs, &intermediate); break;
+			case OpDiv: legal = lhs % rhs == 0; intermediate = lhs / rhs; break;
+			default:
+				verify_fail(ctx, result, "illegal operation");
+				return;
+		}
+
+		if (!legal) {
+			verify_fail(ctx, result, "illegal intermediate result");
+			return;
+		}
+
+		if (intermediate != elem->value) {
+			verify_fail(ctx, result, "wrong intermediate result");
+			return;
+		}
+
+		-- stack_size;
+		stack[stack_size - 1] = intermediate;
+	}
+
+	if (stack_size != 1 || stack[0] != value) {
+		verify_fail(ctx, result, "wrong result");
+		return;
+	}
+
+	if (!target_set_contains(&game->targets, value)) {
+		verify_fail(ctx, result, "result is not a target");
+		return;
+	}
+
+	const uint64_t hash = verify_hash(ctx->ops, ctx->ops_index);
+	__atomic_add_fetch(&result->solution_count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&result->hash_sum, hash, __ATOMIC_RELAXED);
+	__atomic_xor_fetch(&result->hash_xor, hash, __ATOMIC_RELAXED);
+	if (distinct) {
+		__atomic_add_fetch(&result->distinct_count, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&result->distinct_sum, hash, __ATOMIC_RELAXED);
+		__atomic_xor_fetch(&result->distinct_xor, hash, __ATOMIC_RELAXED);
+	}
+	if (value == game->target) {
+		__atomic_add_fetch(&result->target_hits, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// Builds a random expression out of random numbers like generate_game() of
+// test.py, but without intermediate results of 0.
+static void verify_generate_game(VerifyGame *game, uint64_t *random_state) {
+	Number stack[VERIFY_MAX_COUNT];
+
+	for (;;) {
+		const Index count = 1 + random_next(random_state) % VERIFY_MAX_COUNT;
+		Index stack_size = 0;
+		game->count = 0;
+		game->code_size = 0;
+
+		while (game->count < count || stack_size > 1) {
+			if (game->count < count && (stack_size < 2 || random_next(random_state) % 2 == 0)) {
+				const Number number = random_next(random_state) % 2 == 0 ?
+					1 + random_next(random_state) % VERIFY_SMALL_NUMBER :
+					1 + random_next(random_state) % VERIFY_MAX_NUMBER;
+				game->code[game->code_size ++] = (Element){ .op = OpVal, .index = game->count, .value = number };
+				game->numbers[game->count ++] = number;
+				stack[stack_size ++] = number;
+				continue;
+			}
+
+			const Number lhs = stack[stack_size - 2];
+			const Number rhs = stack[stack_size - 1];
+			Number value = 0;
+			Op op = OpAdd;
+			switch (random_next(random_state) % 4) {
+				case 0: op = OpAdd; value = lhs + rhs; break;
+				case 1: op = OpMul; value = lhs * rhs; break;
+				case 2: op = lhs > rhs ? OpSub : OpAdd; value = lhs > rhs ? lhs - rhs : lhs + rhs; break;
+				case 3: op = lhs % rhs == 0 ? OpDiv : OpMul; value = lhs % rhs == 0 ? lhs / rhs : lhs * rhs; break;
+			}
+			game->code[game->code_size ++] = (Element){ .op = op, .index = 0, .value = value };
+			-- stack_size;
+			stack[stack_size - 1] = value;
+		}
+
+		if (stack[0] <= VERIFY_MAX_TARGET) {
+			game->target = stack[0];
+			break;
+		}
+	}
+
+	target_set_create(&game->targets);
+	if (random_next(random_state) % 4 == 0) {
+		const Number range = random_next(random_state) % (VERIFY_MAX_RANGE + 1);
+		target_set_add(&game->targets, (TargetRange){
+			.start = game->target > range ? game->target - range : 1,
+			.end   = game->target + range,
+		});
+	} else {
+		target_set_add(&game->targets, (TargetRange){ .start = game->target, .end = game->target });
+	}
+	target_set_normalize(&game->targets);
+}
+
+static void verify_result_init(VerifyResult *result, const VerifyGame *game, const char *engine) {
+	*result = (VerifyResult){
+		.game           = game,
+		.engine         = engine,
+		.solution_count = 0,
+		.hash_sum       = 0,
+		.hash_xor       = 0,
+		.target_hits    = 0,
+		.error_count    = 0,
+		.distinct_count = 0,
+		.distinct_sum   = 0,
+		.distinct_xor   = 0,
+	};
+}
+
+static void verify_manager_create(ThreadManager *mngr, const VerifyGame *game, const size_t threads, const bool generate, VerifyResult *result) {
+	thread_manager_create(mngr, game->count, threads, PrintRpn, generate);
+	mngr->sink = verify_solution;
+	for (size_t thread_index = 0; thread_index < threads; ++ thread_index) {
+		mngr->solvers[thread_index].sink_data = result;
+	}
+}
+
+static void verify_solve(VerifyResult *result, const VerifyGame *game, const size_t threads, const bool guided) {
+	ThreadManager mngr;
+	verify_manager_create(&mngr, game, threads, false, result);
+	mngr.guided = guided;
+	if (threads > 1) {
+		// hand off work as deep as possible, so there is something to hand off
+		// even for small games
+		mngr.split_count = game->count;
+	}
+	solve(&mngr, &game->targets, game->numbers);
+	thread_manager_destroy(&mngr);
+}
+
+static void verify_shards(VerifyResult *result, const VerifyGame *game, const size_t shard_count) {
+	for (size_t shard_index = 0; shard_index < shard_count; ++ shard_index) {
+		ThreadManager mngr;
+		verify_manager_create(&mngr, game, 1, false, result);
+		prepare_shard(&mngr, &game->targets, game->numbers, shard_index, shard_count);
+		if (mngr.task_count > 0) {
+			solve(&mngr, &game->targets, game->numbers);
+		}
+		thread_manager_destroy(&mngr);
+	}
+}
+
+static void verify_generate(VerifyResult *result, const VerifyGame *game, const size_t threads, const bool distinct) {
+	ThreadManager mngr;
+	verify_manager_create(&mngr, game, threads, true, result);
+	mngr.distinct = distinct;
+	generate(&mngr, &game->targets, game->numbers, result);
+	generate_wait(&mngr);
+	thread_manager_destroy(&mngr);
+}
+
+// Solves the game in a random lane of a batch. The other lanes get random
+// games with the same targets, which are only checked by the sink.
+static void verify_batch(VerifyResult *result, const VerifyGame *game, const size_t threads, const bool distinct, uint64_t *random_state) {
+	ThreadManager mngr;
+	verify_manager_create(&mngr, game, threads, true, result);
+	mngr.batch    = true;
+	mngr.distinct = distinct;
+
+	const size_t lane_count = 1 + random_next(random_state) % BATCH_LANES;
+	const size_t game_lane  = random_next(random_state) % lane_count;
+	VerifyGame others[BATCH_LANES];
+	VerifyResult other_results[BATCH_LANES];
+
+	for (size_t lane_index = 0; lane_index < lane_count; ++ lane_index) {
+		if (lane_index == game_lane) {
+			generate(&mngr, &game->targets, game->numbers, result);
+			continue;
+		}
+
+		VerifyGame *other = &others[lane_index];
+		do {
+			verify_generate_game(other, random_state);
+			target_set_destroy(&other->targets);
+		} while (other->count != game->count);
+		other->targets = game->targets;
+
+		verify_result_init(&other_results[lane_index], other, "batch lane");
+		generate(&mngr, &game->targets, other->numbers, &other_results[lane_index]);
+	}
+
+	generate_wait(&mngr);
+	thread_manager_destroy(&mngr);
+
+	for (size_t lane_index = 0; lane_index < lane_count; ++ lane_index) {
+		if (lane_index != game_lane) {
+			result->error_count += other_results[lane_index].error_count;
+		}
+	}
+}
+
+static bool verify_same(const VerifyResult *expected, const VerifyResult *result) {
+	if (result->error_count > 0) {
+		return false;
+	}
+
+	if (result->solution_count != expected->solution_count ||
+	    result->hash_sum != expected->hash_sum ||
+	    result->hash_xor != expected->hash_xor) {
+		fprintf(stderr, "%s: found %zu solutions, but %s found %zu\n    game: ",
+			result->engine, result->solution_count, expected->engine, expected->solution_count);
+		verify_print_game(stderr, expected->game);
+		return false;
+	}
+
+	return true;
+}
+
+// Like verify_same(), but for an engine that counts every distinct solution
+// once, i.e. with equal numbers only in the order they are given.
+static bool verify_distinct(const VerifyResult *expected, const VerifyResult *result) {
+	if (result->error_count > 0) {
+		return false;
+	}
+
+	if (result->solution_count != expected->distinct_count ||
+	    result->hash_sum != expected->distinct_sum ||
+	    result->hash_xor != expected->distinct_xor) {
+		fprintf(stderr, "%s: found %zu solutions, but %s found %zu distinct ones\n    game: ",
+			result->engine, result->solution_count, expected->engine, expected->distinct_count);
+		verify_print_game(stderr, expected->game);
+		return false;
+	}
+
+	return true;
+}
+
+// Returns if all engines agree and found the known solution.
+static bool verify_game(const VerifyGame *game, const bool cross_check, const size_t threads, uint64_t *random_state) {
+	VerifyResult expected;
+	verify_result_init(&expected, game, "1 thread");
+	verify_solve(&expected, game, 1, false);
+
+	if (expected.error_count > 0) {
+		return false;
+	}
+
+	if (expected.target_hits == 0) {
+		fprintf(stderr, "%s: no solution found\n    game: ", expected.engine);
+		verify_print_game(stderr, game);
+		return false;
+	}
+
+	if (!cross_check) {
+		return true;
+	}
+
+	VerifyResult result;
+	verify_result_init(&result, game, "threads");
+	verify_solve(&result, game, threads, false);
+	if (!verify_same(&expected, &result)) {
+		return false;
+	}
+
+	verify_result_init(&result, game, "guided");
+	verify_solve(&result, game, threads, true);
+	if (!verify_same(&expected, &result)) {
+		return false;
+	}
+
+	verify_result_init(&result, game, "shards");
+	verify_shards(&result, game, 2 + random_next(random_state) % (VERIFY_MAX_SHARDS - 1));
+	if (!verify_same(&expected, &result)) {
+		return false;
+	}
+
+	if (game->count == DEFAULT_NUMBER_COUNT) {
+		verify_result_init(&result, game, "generate");
+		verify_generate(&result, game, threads, false);
+		if (!verify_same(&expected, &result)) {
+			return false;
+		}
+
+		verify_result_init(&result, game, "batch");
+		verify_batch(&result, game, threads, false, random_state);
+		if (!verify_same(&expected, &result)) {
+			return false;
+		}
+
+		verify_result_init(&result, game, "distinct generate");
+		verify_generate(&result, game, threads, true);
+		if (!verify_distinct(&expected, &result)) {
+			return false;
+		}
+
+		verify_result_init(&result, game, "distinct batch");
+		verify_batch(&result, game, threads, true, random_state);
+		if (!verify_distinct(&expected, &result)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Builds the game of the given expression in reverse Polish notation, with
+// its value as the only target.
+static void verify_parse_game(VerifyGame *game, const char *code) {
+	Number stack[VERIFY_MAX_COUNT];
+	Index stack_size = 0;
+	game->count = 0;
+	game->code_size = 0;
+
+	for (const char *ptr = code; *ptr; ++ ptr) {
+		if (*ptr == ' ') {
+			continue;
+		}
+
+		Number value = 0;
+		const char *end = scan_number(ptr, &value);
+		if (end) {
+			assert(game->count < VERIFY_MAX_COUNT);
+			game->code[game->code_size ++] = (Element){ .op = OpVal, .index = game->count, .value = value };
+			game->numbers[game->count ++] = value;
+			stack[stack_size ++] = value;
+			ptr = end - 1;
+			continue;
+		}
+
+		assert(stack_size >= 2);
+		const Number lhs = stack[stack_size - 2];
+		const Number rhs = stack[stack_size - 1];
+		switch (*ptr) {
+			case OpAdd: value = lhs + rhs; break;
+			case OpSub: value = lhs - rhs; break;
+			case OpMul: value = lhs * rhs; break;
+			case OpDiv: value = lhs / rhs; break;
+			default:
+				panicf("illegal operation in verification game: %s", code);
+		}
+		game->code[game->code_size ++] = (Element){ .op = *ptr, .index = 0, .value = value };
+		-- stack_size;
+		stack[stack_size - 1] = value;
+	}
+
+	assert(stack_size == 1);
+	game->target = stack[0];
+	target_set_create(&game->targets);
+	target_set_add(&game->targets, (TargetRange){ .start = game->target, .end = game->target });
+	target_set_normalize(&game->targets);
+}
+
+// The random games are checked on all CPUs at once. Every game has its own
+// random state, derived from the seed and its index, so the games don't
+// depend on which worker checks them or how many workers there are.
+typedef struct VerifyRunS {
+	uint64_t          seed;
+	// 0 for as many games as fit until end_time
+	unsigned long     game_count;
+	double            end_time;
+	size_t            threads;
+	unsigned long     next_game;
+	size_t            fail_count;
+	size_t            success_count;
+} VerifyRun;
+
+static uint64_t verify_game_seed(const uint64_t seed, const unsigned long game_index) {
+	// splitmix64, so neighbouring indices give unrelated states
+	uint64_t state = seed + (game_index + 1) * UINT64_C(0x9E3779B97F4A7C15);
+	state = (state ^ (state >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	state = (state ^ (state >> 27)) * UINT64_C(0x94D049BB133111EB);
+	state ^= state >> 31;
+	// xorshift gets stuck at 0
+	return state != 0 ? state : ANYTIME_SEED;
+}
+
+static void *verify_worker(void *data) {
+	VerifyRun *run = data;
+
+	for (;;) {
+		if (run->game_count == 0 && get_monotonic_time() >= run->end_time) {
+			break;
+		}
+
+		const unsigned long game_index = __atomic_fetch_add(&run->next_game, 1, __ATOMIC_RELAXED);
+		if (run->game_count > 0 && game_index >= run->game_count) {
+			break;
+		}
+
+		uint64_t random_state = verify_game_seed(run->seed, game_index);
+		VerifyGame game;
+		verify_generate_game(&game, &random_state);
+
+		if (verify_game(&game, game_index % VERIFY_CROSS_CHECK == 0, run->threads, &random_state)) {
+			__atomic_add_fetch(&run->success_count, 1, __ATOMIC_RELAXED);
+		} else {
+			__atomic_add_fetch(&run->fail_count, 1, __ATOMIC_RELAXED);
+		}
+
+		target_set_destroy(&game.targets);
+	}
+
+	return NULL;
+}
+
+// Games that are always checked, besides the random ones.
+static const char *const VERIFY_FIXED_GAMES[] = {
+	// the only solution of 813 1 1 2 3 4 75, but it can use either 1 first
+	"75 1 - 4 2 * 3 + * 1 -",
+};
+
+int main(int argc, char *argv[]) {
+	if (argc > 3) {
+		fprintf(stderr, "Usage: %s [GAMES [SEED]]\n", argc > 0 ? argv[0] : "verify");
+		fprintf(stderr, "Without GAMES, or with 0, games are checked for %d seconds.\n", VERIFY_DEFAULT_SECONDS);
+		return 1;
+	}
+
+	const unsigned long game_count = argc > 1 ? parse_number(argv[1], "illegal game count") : 0;
+	const uint64_t seed = argc > 2 ? parse_number(argv[2], "illegal seed") : ANYTIME_SEED;
+
+#ifdef HAS_GET_CPU_COUNT
+	const size_t cpus = get_cpu_count();
+#else
+	const size_t cpus = 1;
+#endif
+	// more threads than numbers are never all busy
+	const size_t threads = cpus > 4 ? cpus : 4;
+
+	if (game_count > 0) {
+		printf("games: %lu, seed: %" PRIu64 ", threads: %zu, workers: %zu\n", game_count, seed, threads, cpus);
+	} else {
+		printf("seconds: %d, seed: %" PRIu64 ", threads: %zu, workers: %zu\n", VERIFY_DEFAULT_SECONDS, seed, threads, cpus);
+	}
+	fflush(stdout);
+
+	uint64_t random_state = seed;
+	size_t fail_count = 0;
+	size_t success_count = 0;
+	const double start_time = get_monotonic_time();
+
+	for (size_t game_index = 0; game_index < sizeof(VERIFY_FIXED_GAMES) / sizeof(VERIFY_FIXED_GAMES[0]); ++ game_index) {
+		VerifyGame game;
+		verify_parse_game(&game, VERIFY_FIXED_GAMES[game_index]);
+
+		if (verify_game(&game, true, threads, &random_state)) {
+			++ success_count;
+		} else {
+			++ fail_count;
+		}
+
+		target_set_destroy(&game.targets);
+	}
+
+	VerifyRun run = {
+		.seed          = seed,
+		.game_count    = game_count,
+		.end_time      = start_time + VERIFY_DEFAULT_SECONDS,
+		.threads       = threads,
+		.next_game     = 0,
+		.fail_count    = 0,
+		.success_count = 0,
+	};
+
+	pthread_t *workers = calloc(cpus, sizeof(pthread_t));
+	if (!workers) {
+		panice("allocating %zu workers", cpus);
+	}
+
+	for (size_t worker_index = 0; worker_index < cpus; ++ worker_index) {
+		const int errnum = pthread_create(&workers[worker_index], NULL, verify_worker, &run);
+		if (errnum != 0) {
+			panicf("creating worker: %s", strerror(errnum));
+		}
+	}
+
+	for (size_t worker_index = 0; worker_index < cpus; ++ worker_index) {
+		const int errnum = pthread_join(workers[worker_index], NULL);
+		if (errnum != 0) {
+			panicf("joining worker: %s", strerror(errnum));
+		}
+	}
+	free(workers);
+
+	fail_count    += run.fail_count;
+	success_count += run.success_count;
+
+	printf("games: %zu, failed: %zu, succeeded: %zu, %.1f seconds\n",
+		run.fail_count + run.success_count, fail_count, success_count, get_monotonic_time() - start_time);
+
+	return fail_count > 0 ? 1 : 0;
+}